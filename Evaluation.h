@@ -0,0 +1,70 @@
+#ifndef EVALUATION_H
+#define EVALUATION_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <algorithm>
+#include <ostream>
+#include <iomanip>
+
+// One configuration of an evaluation sweep and its scores against the LexMapr matches.
+struct Evaluation {
+    std::string engine;
+    int bands = 0;
+    std::string weighting = "none";
+    double singleThreshold = 0;
+    double multipleThreshold = 0;
+    double precision = 0;
+    double recall = 0;
+    double candidatesPerQuery = 0;
+    double matchesPerQuery = 0;
+    double qps = 0;
+    bool pareto = false;
+};
+
+// Micro-averaged precision and recall of the recipe matches against the LexMapr matches, both given as
+// ontology IDs. Recipes without LexMapr matches count only towards precision.
+void score_matches(Evaluation& evaluation, const std::unordered_map<std::string, std::unordered_set<std::string>>& matches,
+                   const std::unordered_map<std::string, std::unordered_set<std::string>>& possible_matches) {
+    size_t predicted = 0, expected = 0, correct = 0;
+    for (const auto& [recipe, ids] : matches) {
+        predicted += ids.size();
+        auto it = possible_matches.find(recipe);
+        if (it == possible_matches.end()) {
+            continue;
+        }
+        for (const auto& id : ids) {
+            correct += it->second.count(id);
+        }
+    }
+    for (const auto& [recipe, ids] : possible_matches) {
+        expected += ids.size();
+    }
+    evaluation.precision = predicted ? static_cast<double>(correct) / predicted : 1.0;
+    evaluation.recall = expected ? static_cast<double>(correct) / expected : 1.0;
+}
+
+// Marks the configurations that no other configuration matches or beats on precision, recall and
+// throughput while beating them on at least one.
+void mark_pareto_frontier(std::vector<Evaluation>& evaluations) {
+    for (auto& candidate : evaluations) {
+        candidate.pareto = std::none_of(evaluations.begin(), evaluations.end(), [&](const Evaluation& other) {
+            return other.precision >= candidate.precision && other.recall >= candidate.recall && other.qps >= candidate.qps
+                && (other.precision > candidate.precision || other.recall > candidate.recall || other.qps > candidate.qps);
+        });
+    }
+}
+
+void write_evaluations(std::ostream& out, const std::vector<Evaluation>& evaluations) {
+    out << std::fixed << std::setprecision(3);
+    out << "engine\tbands\tweighting\tsingle_threshold\tmultiple_threshold\tprecision\trecall\tcandidates_per_query\tmatches_per_query\tqps\tpareto\n";
+    for (const auto& e : evaluations) {
+        out << e.engine << "\t" << e.bands << "\t" << e.weighting << "\t" << e.singleThreshold << "\t" << e.multipleThreshold
+            << "\t" << e.precision << "\t" << e.recall << "\t" << e.candidatesPerQuery << "\t" << e.matchesPerQuery
+            << "\t" << e.qps << "\t" << e.pareto << "\n";
+    }
+}
+
+#endif
@@ -8,8 +8,13 @@
 #include <sstream>
 #include <iomanip>
 #include <unordered_set>
+#include <unordered_map>
+#include <cmath>
 #include <map>
 #include <fstream>
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
 #include <openssl/sha.h>
 #include <tbb/concurrent_unordered_map.h>
 #include <tbb/concurrent_vector.h>
@@ -29,7 +34,18 @@ public:
     }
 
     void insert(const std::vector<std::string>& ngrams, const std::string& docID) {
-        auto minhashSignature = minhash(ngrams, hashFuncs);
+        insert_signature(compute_signature(ngrams), docID);
+    }
+
+    // Inserts a signature computed by compute_signature, e.g. on another index with the same number of
+    // hashes and IDF weights, so that one set of signatures can be banded several ways.
+    void insert_signature(const std::vector<unsigned long>& minhashSignature, const std::string& docID) {
+        if (frozen) {
+            throw std::runtime_error("Insert on frozen LSH");
+        }
+        if (minhashSignature.size() != hashFuncs.size()) {
+            throw std::runtime_error("Signature length does not match the number of hash functions");
+        }
         signatures[docID] = minhashSignature;
 
         for (int band = 0; band < numBands; ++band) {
@@ -41,8 +57,156 @@ public:
         }
     }
 
-    std::unordered_set<std::string> query(const std::vector<std::string>& queryNgrams, double threshold = 0.4) {
-        auto querySignature = minhash(queryNgrams, hashFuncs);
+    // Switch to TF-IDF weighted MinHash, with inverse document frequencies computed over documents
+    // (the n-grams of every record that will be inserted). Throws once records have been inserted or
+    // the index is frozen, since their signatures would be unweighted.
+    void fit_idf(const std::vector<std::vector<std::string>>& documents) {
+        if (frozen || !signatures.empty()) {
+            throw std::runtime_error("fit_idf must be called before the first insert");
+        }
+        std::unordered_map<std::string, size_t> frequency;
+        for (const auto& document : documents) {
+            std::unordered_set<std::string> distinct(document.begin(), document.end());
+            for (const auto& ngram : distinct) {
+                ++frequency[ngram];
+            }
+        }
+
+        numDocuments = documents.size();
+        idf.clear();
+        for (const auto& [ngram, count] : frequency) {
+            idf[ngram] = inverse_document_frequency(count);
+        }
+        weighted = true;
+    }
+
+    bool is_weighted() const {
+        return weighted;
+    }
+
+    // Convert the build-phase buckets into read-only open-addressing tables, one per band,
+    // whose slots point into a single CSR-style posting array of document ordinals.
+    // The concurrent containers are released afterwards; the index can no longer be modified.
+    void freeze() {
+        if (frozen) {
+            return;
+        }
+        for (const auto& [docID, signature] : signatures) {
+            if (signature.size() != hashFuncs.size()) {
+                throw std::runtime_error("Signature of " + docID + " does not match the number of hash functions");
+            }
+        }
+
+        std::unordered_map<std::string, uint32_t> ordinals;
+        docIDs.clear();
+        docIDs.reserve(signatures.size());
+        sigLength = signatures.empty() ? 0 : signatures.begin()->second.size();
+        flatSignatures.clear();
+        flatSignatures.reserve(signatures.size() * sigLength);
+        for (const auto& [docID, signature] : signatures) {
+            ordinals[docID] = static_cast<uint32_t>(docIDs.size());
+            docIDs.push_back(docID);
+            flatSignatures.insert(flatSignatures.end(), signature.begin(), signature.end());
+        }
+
+        bandTables.assign(numBands, std::vector<BandSlot>());
+        postings.clear();
+        for (int band = 0; band < numBands; ++band) {
+            auto& bandBucket = buckets[band];
+            size_t capacity = 1;
+            while (capacity < bandBucket.size() * 2) {
+                capacity <<= 1;
+            }
+            auto& table = bandTables[band];
+            table.assign(capacity, BandSlot{0, 0, 0});
+
+            for (const auto& [key, value] : bandBucket) {
+                uint64_t bandKey = std::stoull(key.substr(0, 16), nullptr, 16);
+                size_t slot = bandKey & (capacity - 1);
+                while (table[slot].count != 0 && table[slot].key != bandKey) {
+                    slot = (slot + 1) & (capacity - 1);
+                }
+
+                // Distinct band hashes sharing a 64-bit prefix are merged; this can only add candidates
+                // to the verification step, never drop one.
+                auto& entry = table[slot];
+                if (entry.count != 0) {
+                    std::vector<uint32_t> merged(postings.begin() + entry.offset, postings.begin() + entry.offset + entry.count);
+                    for (const auto& docID : value) {
+                        merged.push_back(ordinals.at(docID));
+                    }
+                    entry.offset = static_cast<uint32_t>(postings.size());
+                    entry.count = static_cast<uint32_t>(merged.size());
+                    postings.insert(postings.end(), merged.begin(), merged.end());
+                    continue;
+                }
+
+                entry.key = bandKey;
+                entry.offset = static_cast<uint32_t>(postings.size());
+                entry.count = static_cast<uint32_t>(value.size());
+                for (const auto& docID : value) {
+                    postings.push_back(ordinals.at(docID));
+                }
+            }
+        }
+        postings.shrink_to_fit();
+
+        buckets.clear();
+        signatures.clear();
+        frozen = true;
+    }
+
+    bool is_frozen() const {
+        return frozen;
+    }
+
+    size_t num_hashes() const {
+        return hashFuncs.size();
+    }
+
+    // Document IDs of a frozen index, indexed by the ordinals query_ordinals returns.
+    const std::vector<std::string>& doc_ids() const {
+        return docIDs;
+    }
+
+    // Sorted ordinals of the documents matching a signature of num_hashes() slots. Frozen index only.
+    // If candidateCount is given, it receives the number of distinct bucket candidates before verification.
+    std::vector<uint32_t> query_ordinals(const unsigned long* querySignature, double threshold, size_t* candidateCount = nullptr) const {
+        if (!frozen) {
+            throw std::runtime_error("query_ordinals on unfrozen LSH");
+        }
+
+        size_t required = required_matches(sigLength, threshold);
+        return collect_ordinals(
+            [&](int band) { return computeBandKey(querySignature, band * bandSize, (band + 1) * bandSize); },
+            [&](const unsigned long* docSignature) { return matches_at_least(querySignature, docSignature, sigLength, required); },
+            candidateCount);
+    }
+
+    std::unordered_set<std::string> query(const std::vector<std::string>& queryNgrams, double threshold = 0.4,
+                                          size_t* candidateCount = nullptr) {
+        return query_signature(compute_signature(queryNgrams), threshold, candidateCount);
+    }
+
+    std::vector<unsigned long> compute_signature(const std::vector<std::string>& ngrams) const {
+        if (!weighted) {
+            return minhash(ngrams, hashFuncs);
+        }
+        std::vector<double> weights;
+        weights.reserve(ngrams.size());
+        for (const auto& ngram : ngrams) {
+            auto it = idf.find(ngram);
+            weights.push_back(it == idf.end() ? inverse_document_frequency(0) : it->second);
+        }
+        return weighted_minhash(ngrams, weights, hashFuncs);
+    }
+
+    // Query with a signature computed elsewhere from the same hash family, e.g. by a shard coordinator.
+    std::unordered_set<std::string> query_signature(const std::vector<unsigned long>& querySignature, double threshold = 0.4,
+                                                    size_t* candidateCount = nullptr) {
+        if (frozen) {
+            return query_frozen(querySignature, threshold, candidateCount);
+        }
         std::unordered_set<std::string> candidateDocs;
         
         tbb::parallel_for(0, numBands, [&](int band) {
@@ -61,12 +225,17 @@ public:
             }
         });
 
+        if (candidateCount) {
+            *candidateCount = candidateDocs.size();
+        }
+
         tbb::concurrent_unordered_map<std::string, bool> filteredDocs;
+        size_t required = required_matches(querySignature.size(), threshold);
         
         tbb::parallel_for_each(candidateDocs.begin(), candidateDocs.end(), [&](const std::string& docID) {
             auto& docSignature = signatures.at(docID);
-            double similarity = jaccard_similarity(querySignature, docSignature);
-            if (similarity >= threshold) {
+            assert(docSignature.size() == querySignature.size());
+            if (matches_at_least(querySignature.data(), docSignature.data(), querySignature.size(), required)) {
                 filteredDocs[docID] = true;
             }
         });
@@ -79,12 +248,18 @@ public:
         return result;
     }
 
-    void save_to_disk(const std::string& filename) const {
+    // Returns false if the index could not be written completely.
+    bool save_to_disk(const std::string& filename) const {
+        if (frozen) {
+            std::cerr << "Cannot save a frozen LSH index to " << filename << std::endl;
+            return false;
+        }
+
         std::ofstream outFile(filename, std::ios::binary);
 
         if (!outFile.is_open()) {
             std::cerr << "Failed to open file: " << filename << std::endl;
-            return;
+            return false;
         }
 
         // Serialize number of bands and band size
@@ -126,41 +301,93 @@ public:
             outFile.write(reinterpret_cast<const char*>(signature.data()), sigVecSize * sizeof(unsigned long));
         }
 
+        // Weighted indexes end with their document count and IDF table; unweighted files stop here.
+        if (weighted) {
+            outFile.write(reinterpret_cast<const char*>(&numDocuments), sizeof(numDocuments));
+            size_t idfSize = idf.size();
+            outFile.write(reinterpret_cast<const char*>(&idfSize), sizeof(idfSize));
+            for (const auto& [ngram, weight] : idf) {
+                size_t ngramSize = ngram.size();
+                outFile.write(reinterpret_cast<const char*>(&ngramSize), sizeof(ngramSize));
+                outFile.write(ngram.c_str(), ngramSize);
+                outFile.write(reinterpret_cast<const char*>(&weight), sizeof(weight));
+            }
+        }
+
         outFile.close();
+        if (!outFile) {
+            std::cerr << "Failed to write file: " << filename << std::endl;
+            return false;
+        }
+        return true;
     }
 
-    // Load the LSH data from a file
-    void load_from_disk(const std::string& filename) {
+    // Load the LSH data from a file. Returns false if the file is missing or truncated, in which
+    // case the index is left empty, as constructed, and can be rebuilt with insert().
+    bool load_from_disk(const std::string& filename) {
+        if (frozen) {
+            std::cerr << "Cannot load " << filename << " into a frozen LSH index" << std::endl;
+            return false;
+        }
+
         std::ifstream inFile(filename, std::ios::binary);
 
         if (!inFile.is_open()) {
             std::cerr << "Failed to open file: " << filename << std::endl;
-            return;
+            return false;
         }
 
+        int configuredBands = numBands;
+        int configuredBandSize = bandSize;
+        auto discard = [&](const char* message) {
+            std::cerr << message << filename << std::endl;
+            numBands = configuredBands;
+            bandSize = configuredBandSize;
+            buckets.clear();
+            buckets.resize(numBands);
+            signatures.clear();
+            weighted = false;
+            numDocuments = 0;
+            idf.clear();
+            return false;
+        };
+
         // Deserialize number of bands and band size
         inFile.read(reinterpret_cast<char*>(&numBands), sizeof(numBands));
         inFile.read(reinterpret_cast<char*>(&bandSize), sizeof(bandSize));
+        if (!inFile || numBands <= 0 || bandSize <= 0) {
+            return discard("Invalid LSH index file: ");
+        }
+        if (static_cast<size_t>(numBands) * bandSize > hashFuncs.size()) {
+            return discard("LSH index file has more band rows than this index has hash functions: ");
+        }
 
-        // Deserialize buckets
+        // Deserialize buckets. A size read past the end of a truncated file is partial, so every size is
+        // checked before it is used.
         buckets.resize(numBands);
-        for (int i = 0; i < numBands; ++i) {
-            size_t bucketSize;
+        for (int i = 0; i < numBands && inFile; ++i) {
+            size_t bucketSize = 0;
             inFile.read(reinterpret_cast<char*>(&bucketSize), sizeof(bucketSize));
 
-            for (size_t j = 0; j < bucketSize; ++j) {
-                size_t keySize;
-                inFile.read(reinterpret_cast<char*>(&keySize), sizeof(keySize));
+            for (size_t j = 0; j < bucketSize && inFile; ++j) {
+                size_t keySize = 0;
+                if (!inFile.read(reinterpret_cast<char*>(&keySize), sizeof(keySize))) {
+                    break;
+                }
                 std::string key(keySize, '\0');
                 inFile.read(&key[0], keySize);
 
-                size_t valueSize;
-                inFile.read(reinterpret_cast<char*>(&valueSize), sizeof(valueSize));
+                size_t valueSize = 0;
+                if (!inFile.read(reinterpret_cast<char*>(&valueSize), sizeof(valueSize))) {
+                    break;
+                }
                 tbb::concurrent_vector<std::string> value(valueSize);
 
-                for (size_t k = 0; k < valueSize; ++k) {
-                    size_t docIDSize;
-                    inFile.read(reinterpret_cast<char*>(&docIDSize), sizeof(docIDSize));
+                for (size_t k = 0; k < valueSize && inFile; ++k) {
+                    size_t docIDSize = 0;
+                    if (!inFile.read(reinterpret_cast<char*>(&docIDSize), sizeof(docIDSize))) {
+                        break;
+                    }
                     std::string docID(docIDSize, '\0');
                     inFile.read(&docID[0], docIDSize);
                     value[k] = docID;
@@ -171,27 +398,61 @@ public:
         }
 
         // Deserialize signatures
-        size_t sigSize;
+        size_t sigSize = 0;
         inFile.read(reinterpret_cast<char*>(&sigSize), sizeof(sigSize));
 
-        for (size_t i = 0; i < sigSize; ++i) {
-            size_t docIDSize;
-            inFile.read(reinterpret_cast<char*>(&docIDSize), sizeof(docIDSize));
+        for (size_t i = 0; i < sigSize && inFile; ++i) {
+            size_t docIDSize = 0;
+            if (!inFile.read(reinterpret_cast<char*>(&docIDSize), sizeof(docIDSize))) {
+                break;
+            }
             std::string docID(docIDSize, '\0');
             inFile.read(&docID[0], docIDSize);
 
-            size_t sigVecSize;
-            inFile.read(reinterpret_cast<char*>(&sigVecSize), sizeof(sigVecSize));
+            size_t sigVecSize = 0;
+            if (!inFile.read(reinterpret_cast<char*>(&sigVecSize), sizeof(sigVecSize))) {
+                break;
+            }
+            if (sigVecSize != hashFuncs.size()) {
+                return discard("LSH index file signatures do not match this index's number of hash functions: ");
+            }
             std::vector<unsigned long> signature(sigVecSize);
             inFile.read(reinterpret_cast<char*>(signature.data()), sigVecSize * sizeof(unsigned long));
 
             signatures[docID] = signature;
         }
+        if (!inFile) {
+            return discard("Truncated LSH index file: ");
+        }
+
+        // Weighted indexes end with their document count and IDF table; unweighted files stop here.
+        if (inFile.peek() != std::ifstream::traits_type::eof()) {
+            size_t idfSize = 0;
+            inFile.read(reinterpret_cast<char*>(&numDocuments), sizeof(numDocuments));
+            inFile.read(reinterpret_cast<char*>(&idfSize), sizeof(idfSize));
+            idf.clear();
+            for (size_t i = 0; i < idfSize && inFile; ++i) {
+                size_t ngramSize = 0;
+                if (!inFile.read(reinterpret_cast<char*>(&ngramSize), sizeof(ngramSize))) {
+                    break;
+                }
+                std::string ngram(ngramSize, '\0');
+                inFile.read(&ngram[0], ngramSize);
+                double weight;
+                inFile.read(reinterpret_cast<char*>(&weight), sizeof(weight));
+                idf[ngram] = weight;
+            }
+            if (!inFile) {
+                return discard("Truncated LSH index file: ");
+            }
+            weighted = true;
+        }
 
         inFile.close();
+        return true;
     }
 
-private:
+protected:
     int numBands;
     int bandSize;
     std::vector<HashFunc> hashFuncs;
@@ -199,6 +460,97 @@ private:
     tbb::concurrent_unordered_map<std::string, std::vector<unsigned long>> signatures;
     tbb::spin_mutex mutex_for_candidateDocs;
 
+    bool weighted = false;
+    size_t numDocuments = 0;
+    std::unordered_map<std::string, double> idf;
+
+    // Smoothed so that every weight is positive; n-grams absent from the index get the largest weight.
+    double inverse_document_frequency(size_t frequency) const {
+        return std::log((1.0 + numDocuments) / (1.0 + frequency)) + 1.0;
+    }
+
+    struct BandSlot {
+        uint64_t key;
+        uint32_t offset;
+        uint32_t count;
+    };
+
+    bool frozen = false;
+    size_t sigLength = 0;
+    std::vector<std::string> docIDs;
+    std::vector<unsigned long> flatSignatures;
+    std::vector<std::vector<BandSlot>> bandTables;
+    std::vector<uint32_t> postings;
+
+    std::unordered_set<std::string> query_frozen(const std::vector<unsigned long>& querySignature, double threshold,
+                                                 size_t* candidateCount = nullptr) const {
+        std::unordered_set<std::string> result;
+        for (uint32_t ordinal : query_ordinals(querySignature.data(), threshold, candidateCount)) {
+            result.insert(docIDs[ordinal]);
+        }
+        return result;
+    }
+
+    // Frozen query core: looks up bandKey(band) in every band table, then keeps the distinct candidates
+    // whose signature passes verify. Reports the number of candidates before verification if asked.
+    template <typename BandKey, typename Verify>
+    std::vector<uint32_t> collect_ordinals(BandKey&& bandKey, Verify&& verify, size_t* candidateCount) const {
+        std::vector<uint32_t> candidates;
+        for (int band = 0; band < numBands; ++band) {
+            lookup_band(band, bandKey(band), candidates);
+        }
+
+        std::sort(candidates.begin(), candidates.end());
+        candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+        if (candidateCount) {
+            *candidateCount = candidates.size();
+        }
+
+        std::vector<uint32_t> result;
+        for (uint32_t ordinal : candidates) {
+            if (verify(flatSignatures.data() + ordinal * sigLength)) {
+                result.push_back(ordinal);
+            }
+        }
+        return result;
+    }
+
+    // Append the postings of the frozen bucket for bandKey, if any, to candidates.
+    void lookup_band(int band, uint64_t bandKey, std::vector<uint32_t>& candidates) const {
+        const auto& table = bandTables[band];
+        if (table.empty()) {
+            return;
+        }
+        size_t mask = table.size() - 1;
+        size_t slot = bandKey & mask;
+        while (table[slot].count != 0) {
+            if (table[slot].key == bandKey) {
+                candidates.insert(candidates.end(), postings.begin() + table[slot].offset,
+                                  postings.begin() + table[slot].offset + table[slot].count);
+                return;
+            }
+            slot = (slot + 1) & mask;
+        }
+    }
+
+    // Same SHA1 digest as computeBandHash, folded to the 64-bit value that its first 16 hex digits encode.
+    uint64_t computeBandKey(const unsigned long* signature, int start, int end) const {
+        std::ostringstream oss;
+        for (int i = start; i < end; ++i) {
+            oss << signature[i];
+        }
+        std::string combined = oss.str();
+
+        unsigned char hash[SHA_DIGEST_LENGTH];
+        SHA1(reinterpret_cast<const unsigned char*>(combined.c_str()), combined.size(), hash);
+
+        uint64_t key = 0;
+        for (int i = 0; i < 8; ++i) {
+            key = (key << 8) | hash[i];
+        }
+        return key;
+    }
+
     std::string computeBandHash(const std::vector<unsigned long>& signature, int start, int end) {
         std::ostringstream oss;
         for (int i = start; i < end; ++i) {
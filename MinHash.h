@@ -9,6 +9,11 @@
 #include <sstream>
 #include <cassert>
 #include <climits>
+#include <array>
+#include <cmath>
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
 
 class HashFunc {
 public:
@@ -47,17 +52,213 @@ std::vector<unsigned long> minhash(const std::vector<std::string>& ngrams, const
     return minhashSignatures;
 }
 
-double jaccard_similarity(const std::vector<unsigned long>& signature1, const std::vector<unsigned long>& signature2) {
-    assert(signature1.size() == signature2.size());
+// Weighted MinHash: each slot keeps the n-gram that wins an exponential race -log(u) / weight, where u is
+// derived from the slot's hash in (0, 1), and stores that n-gram's hash. Two signatures agree in a slot with
+// probability equal to the weighted (probability) Jaccard similarity of the two sets. With all weights
+// equal this selects the same n-gram as minhash and produces an identical signature.
+std::vector<unsigned long> weighted_minhash(const std::vector<std::string>& ngrams, const std::vector<double>& weights,
+                                           const std::vector<HashFunc>& hashFuncs) {
+    assert(ngrams.size() == weights.size());
+    std::vector<unsigned long> minhashSignatures(hashFuncs.size(), ULONG_MAX);
+    std::vector<double> minKeys(hashFuncs.size(), HUGE_VAL);
+
+    for (size_t j = 0; j < ngrams.size(); ++j) {
+        for (size_t i = 0; i < hashFuncs.size(); ++i) {
+            unsigned long hashVal = hashFuncs[i](ngrams[j]);
+            // Complemented so that a smaller hash gives a larger u and therefore a smaller key.
+            double u = (static_cast<double>(~hashVal >> 11) + 0.5) * 0x1.0p-53;
+            double key = -std::log(u) / weights[j];
+            if (key < minKeys[i] || (key == minKeys[i] && hashVal < minhashSignatures[i])) {
+                minKeys[i] = key;
+                minhashSignatures[i] = hashVal;
+            }
+        }
+    }
+
+    return minhashSignatures;
+}
+
+// Fixed-length signature for configurations known at compile time.
+template <size_t N>
+std::array<unsigned long, N> minhash(const std::vector<std::string>& ngrams, const std::vector<HashFunc>& hashFuncs) {
+    assert(hashFuncs.size() == N);
+    std::array<unsigned long, N> minhashSignatures;
+    minhashSignatures.fill(ULONG_MAX);
 
+    for (const auto& ngram : ngrams) {
+        for (size_t i = 0; i < N; ++i) {
+            unsigned long hashVal = hashFuncs[i](ngram);
+            minhashSignatures[i] = std::min(minhashSignatures[i], hashVal);
+        }
+    }
+
+    return minhashSignatures;
+}
+
+double jaccard_similarity(const unsigned long* signature1, const unsigned long* signature2, size_t length) {
     int matchCount = 0;
-    for (size_t i = 0; i < signature1.size(); ++i) {
+    for (size_t i = 0; i < length; ++i) {
         if (signature1[i] == signature2[i]) {
             ++matchCount;
         }
     }
 
-    return static_cast<double>(matchCount) / signature1.size();
+    return static_cast<double>(matchCount) / length;
 }
 
+double jaccard_similarity(const std::vector<unsigned long>& signature1, const std::vector<unsigned long>& signature2) {
+    assert(signature1.size() == signature2.size());
+
+    return jaccard_similarity(signature1.data(), signature2.data(), signature1.size());
+}
+
+// Smallest number of matching slots for which jaccard_similarity reaches threshold.
+size_t required_matches(size_t length, double threshold) {
+    size_t required = threshold <= 0 ? 0 : static_cast<size_t>(std::ceil(threshold * length));
+    while (required > 0 && static_cast<double>(required - 1) / length >= threshold) {
+        --required;
+    }
+    while (required <= length && static_cast<double>(required) / length < threshold) {
+        ++required;
+    }
+    return required;
+}
+
+// Threshold test on two signatures. Slots are compared in blocks of 16, and the test stops as soon
+// as the required count is reached or can no longer be reached with the remaining slots. The kernels
+// are always inlined into the fixed-length variants below, where the length becomes a constant.
+inline __attribute__((always_inline))
+bool matches_at_least_scalar(const unsigned long* signature1, const unsigned long* signature2, size_t length, size_t required) {
+    size_t matchCount = 0;
+    size_t i = 0;
+    for (; i + 16 <= length; i += 16) {
+#pragma GCC unroll 16
+        for (size_t k = 0; k < 16; ++k) {
+            matchCount += signature1[i + k] == signature2[i + k];
+        }
+        if (matchCount >= required) {
+            return true;
+        }
+        if (matchCount + (length - i - 16) < required) {
+            return false;
+        }
+    }
+#pragma GCC unroll 16
+    for (; i < length; ++i) {
+        matchCount += signature1[i] == signature2[i];
+    }
+    return matchCount >= required;
+}
+
+#if defined(__x86_64__)
+static_assert(sizeof(unsigned long) == 8, "SIMD signature comparison expects 64-bit slots");
+
+inline __attribute__((always_inline, target("sse4.1")))
+bool matches_at_least_sse41(const unsigned long* signature1, const unsigned long* signature2, size_t length, size_t required) {
+    size_t matchCount = 0;
+    size_t i = 0;
+    for (; i + 16 <= length; i += 16) {
+#pragma GCC unroll 16
+        for (size_t k = 0; k < 16; k += 2) {
+            __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(signature1 + i + k));
+            __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(signature2 + i + k));
+            matchCount += __builtin_popcount(_mm_movemask_pd(_mm_castsi128_pd(_mm_cmpeq_epi64(a, b))));
+        }
+        if (matchCount >= required) {
+            return true;
+        }
+        if (matchCount + (length - i - 16) < required) {
+            return false;
+        }
+    }
+#pragma GCC unroll 16
+    for (; i < length; ++i) {
+        matchCount += signature1[i] == signature2[i];
+    }
+    return matchCount >= required;
+}
+
+inline __attribute__((always_inline, target("avx2")))
+bool matches_at_least_avx2(const unsigned long* signature1, const unsigned long* signature2, size_t length, size_t required) {
+    size_t matchCount = 0;
+    size_t i = 0;
+    for (; i + 16 <= length; i += 16) {
+#pragma GCC unroll 16
+        for (size_t k = 0; k < 16; k += 4) {
+            __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(signature1 + i + k));
+            __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(signature2 + i + k));
+            matchCount += __builtin_popcount(_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(a, b))));
+        }
+        if (matchCount >= required) {
+            return true;
+        }
+        if (matchCount + (length - i - 16) < required) {
+            return false;
+        }
+    }
+#pragma GCC unroll 16
+    for (; i < length; ++i) {
+        matchCount += signature1[i] == signature2[i];
+    }
+    return matchCount >= required;
+}
+#endif
+
+using MatchKernel = bool (*)(const unsigned long*, const unsigned long*, size_t, size_t);
+
+MatchKernel select_match_kernel() {
+#if defined(__x86_64__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return matches_at_least_avx2;
+    }
+    if (__builtin_cpu_supports("sse4.1")) {
+        return matches_at_least_sse41;
+    }
+#endif
+    return matches_at_least_scalar;
+}
+
+// Picked once at startup from the instruction sets the CPU reports.
+const MatchKernel matches_at_least = select_match_kernel();
+
+// The same kernels compiled for one signature length, so that the block loop and tail are unrolled.
+using FixedMatchKernel = bool (*)(const unsigned long*, const unsigned long*, size_t);
+
+template <size_t Length>
+bool matches_at_least_fixed_scalar(const unsigned long* signature1, const unsigned long* signature2, size_t required) {
+    return matches_at_least_scalar(signature1, signature2, Length, required);
+}
+
+#if defined(__x86_64__)
+template <size_t Length>
+__attribute__((target("sse4.1")))
+bool matches_at_least_fixed_sse41(const unsigned long* signature1, const unsigned long* signature2, size_t required) {
+    return matches_at_least_sse41(signature1, signature2, Length, required);
+}
+
+template <size_t Length>
+__attribute__((target("avx2")))
+bool matches_at_least_fixed_avx2(const unsigned long* signature1, const unsigned long* signature2, size_t required) {
+    return matches_at_least_avx2(signature1, signature2, Length, required);
+}
+#endif
+
+template <size_t Length>
+FixedMatchKernel select_fixed_match_kernel() {
+#if defined(__x86_64__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return matches_at_least_fixed_avx2<Length>;
+    }
+    if (__builtin_cpu_supports("sse4.1")) {
+        return matches_at_least_fixed_sse41<Length>;
+    }
+#endif
+    return matches_at_least_fixed_scalar<Length>;
+}
+
+template <size_t Length>
+inline const FixedMatchKernel matches_at_least_fixed = select_fixed_match_kernel<Length>();
+
 #endif
\ No newline at end of file
@@ -4,6 +4,7 @@
 #include <string>
 #include <vector>
 #include <sstream>
+#include "StopWords.h"
 
 std::vector<std::string> split(const std::string &text) {
     std::istringstream iss(text);
@@ -15,6 +16,32 @@ std::vector<std::string> split(const std::string &text) {
     return tokens;
 }
 
+// Lowercases the words of a phrase, strips non-letters and drops stop words.
+std::vector<std::string> filter_string(const std::string& input_string) {
+    std::istringstream iss(input_string);
+    std::vector<std::string> words;
+    std::string word;
+
+    std::string filtered_word;
+
+    while (iss >> word) {
+        filtered_word.clear();
+        for (char ch : word) {
+            if (std::isalpha(ch) || std::isspace(ch)) {
+                filtered_word += std::tolower(ch);
+            }
+        }
+        if (filtered_word.empty()) {
+            continue;
+        }
+        if (!is_stop_word(filtered_word)) {
+            words.push_back(std::move(filtered_word));
+            filtered_word = std::string();
+        }
+    }
+    return words;
+}
+
 std::vector<std::string> text_to_ngrams(const std::string& text, int n = 3) {
     std::vector<std::string> ngrams;
     if (text.size() < n) {
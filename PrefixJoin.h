@@ -0,0 +1,246 @@
+#ifndef PREFIXJOIN_H
+#define PREFIXJOIN_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+
+// Exact Jaccard set-similarity join over n-gram sets, using prefix, length and positional filtering
+// (AllPairs/PPJoin). Tokens are ordered by ascending document frequency over the indexed records, so
+// prefixes consist of the rarest n-grams and probe short posting lists.
+//
+// Records are added with insert() and the index is built by freeze(). Only the prefixes needed for
+// minThreshold are indexed; queries below it fall back to a scan of the length-compatible records.
+class PrefixJoin {
+public:
+    PrefixJoin(double minThreshold = 0.5) : minThreshold(minThreshold) {}
+
+    void insert(const std::vector<std::string>& ngrams, const std::string& docID) {
+        if (frozen) {
+            throw std::runtime_error("Insert on frozen PrefixJoin");
+        }
+        auto [it, inserted] = ordinals.try_emplace(docID, static_cast<uint32_t>(docIDs.size()));
+        if (inserted) {
+            docIDs.push_back(docID);
+            rawRecords.emplace_back();
+        }
+        auto& record = rawRecords[it->second];
+        record.assign(ngrams.begin(), ngrams.end());
+        std::sort(record.begin(), record.end());
+        record.erase(std::unique(record.begin(), record.end()), record.end());
+    }
+
+    void freeze() {
+        if (frozen) {
+            return;
+        }
+
+        // Order tokens by document frequency, rarest first.
+        std::unordered_map<std::string, uint32_t> frequency;
+        for (const auto& record : rawRecords) {
+            for (const auto& token : record) {
+                ++frequency[token];
+            }
+        }
+        std::vector<std::pair<uint32_t, std::string>> order;
+        order.reserve(frequency.size());
+        for (auto& [token, count] : frequency) {
+            order.emplace_back(count, token);
+        }
+        std::sort(order.begin(), order.end());
+        tokenRanks.reserve(order.size());
+        for (uint32_t rank = 0; rank < order.size(); ++rank) {
+            tokenRanks[order[rank].second] = rank;
+        }
+
+        recordOffsets.assign(1, 0);
+        for (const auto& record : rawRecords) {
+            size_t start = tokens.size();
+            for (const auto& token : record) {
+                tokens.push_back(tokenRanks.at(token));
+            }
+            std::sort(tokens.begin() + start, tokens.end());
+            recordOffsets.push_back(static_cast<uint32_t>(tokens.size()));
+        }
+        rawRecords.clear();
+        rawRecords.shrink_to_fit();
+        ordinals.clear();
+
+        // CSR posting lists over the indexed prefixes, each sorted by record size for the length filter.
+        std::vector<uint32_t> counts(order.size() + 1, 0);
+        for (uint32_t doc = 0; doc < docIDs.size(); ++doc) {
+            uint32_t size = record_size(doc);
+            uint32_t prefix = prefix_length(size, minThreshold);
+            for (uint32_t j = 0; j < prefix; ++j) {
+                ++counts[tokens[recordOffsets[doc] + j] + 1];
+            }
+        }
+        for (size_t i = 1; i < counts.size(); ++i) {
+            counts[i] += counts[i - 1];
+        }
+        postingOffsets = counts;
+        postings.resize(counts.back());
+        for (uint32_t doc = 0; doc < docIDs.size(); ++doc) {
+            uint32_t size = record_size(doc);
+            uint32_t prefix = prefix_length(size, minThreshold);
+            for (uint32_t j = 0; j < prefix; ++j) {
+                postings[counts[tokens[recordOffsets[doc] + j]]++] = Posting{doc, j, size};
+            }
+        }
+        for (size_t token = 0; token + 1 < postingOffsets.size(); ++token) {
+            std::stable_sort(postings.begin() + postingOffsets[token], postings.begin() + postingOffsets[token + 1],
+                             [](const Posting& a, const Posting& b) { return a.size < b.size; });
+        }
+
+        frozen = true;
+    }
+
+    bool is_frozen() const {
+        return frozen;
+    }
+
+    // If candidateCount is given, it receives the number of distinct records reached through the prefix
+    // posting lists (or, below minThreshold, of length-compatible records) before verification.
+    std::unordered_set<std::string> query(const std::vector<std::string>& queryNgrams, double threshold = 0.4,
+                                          size_t* candidateCount = nullptr) const {
+        if (!frozen) {
+            throw std::runtime_error("Query on PrefixJoin before freeze");
+        }
+
+        // Tokens never seen in the index sort before every indexed token and can never be shared.
+        std::vector<uint32_t> queryTokens;
+        std::unordered_set<std::string> distinct(queryNgrams.begin(), queryNgrams.end());
+        uint32_t unknown = 0;
+        for (const auto& ngram : distinct) {
+            auto it = tokenRanks.find(ngram);
+            if (it == tokenRanks.end()) {
+                ++unknown;
+            }
+            else {
+                queryTokens.push_back(it->second);
+            }
+        }
+        std::sort(queryTokens.begin(), queryTokens.end());
+
+        uint32_t querySize = static_cast<uint32_t>(distinct.size());
+        uint32_t minSize = static_cast<uint32_t>(std::ceil(threshold * querySize - epsilon));
+        uint32_t maxSize = threshold > 0 ? static_cast<uint32_t>(std::floor(querySize / threshold + epsilon)) : UINT32_MAX;
+
+        std::unordered_set<std::string> result;
+        if (threshold < minThreshold) {
+            size_t scanned = 0;
+            for (uint32_t doc = 0; doc < docIDs.size(); ++doc) {
+                uint32_t size = record_size(doc);
+                if (size >= minSize && size <= maxSize) {
+                    ++scanned;
+                    if (verify(queryTokens, querySize, doc, threshold)) {
+                        result.insert(docIDs[doc]);
+                    }
+                }
+            }
+            if (candidateCount) {
+                *candidateCount = scanned;
+            }
+            return result;
+        }
+
+        thread_local std::vector<char> seen;
+        thread_local std::vector<uint32_t> touched;
+        seen.resize(docIDs.size(), 0);
+        touched.clear();
+
+        uint32_t prefix = prefix_length(querySize, threshold);
+        for (uint32_t i = unknown; i < prefix && i - unknown < queryTokens.size(); ++i) {
+            uint32_t token = queryTokens[i - unknown];
+            auto begin = postings.begin() + postingOffsets[token];
+            auto end = postings.begin() + postingOffsets[token + 1];
+            auto it = std::lower_bound(begin, end, minSize, [](const Posting& p, uint32_t size) { return p.size < size; });
+            for (; it != end && it->size <= maxSize; ++it) {
+                if (seen[it->doc]) {
+                    continue;
+                }
+                seen[it->doc] = 1;
+                touched.push_back(it->doc);
+
+                // Positional filter: this is the first shared token, so the overlap is bounded by
+                // what remains after position i in the query and position j in the record.
+                uint32_t required = required_overlap(querySize, it->size, threshold);
+                uint32_t bound = 1 + std::min(querySize - i - 1, it->size - it->pos - 1);
+                if (bound >= required && verify(queryTokens, querySize, it->doc, threshold)) {
+                    result.insert(docIDs[it->doc]);
+                }
+            }
+        }
+
+        for (uint32_t doc : touched) {
+            seen[doc] = 0;
+        }
+        if (candidateCount) {
+            *candidateCount = touched.size();
+        }
+        return result;
+    }
+
+private:
+    struct Posting {
+        uint32_t doc;
+        uint32_t pos;
+        uint32_t size;
+    };
+
+    // Makes the filters err on the side of keeping a candidate when t * |x| is not exact in floating point.
+    static constexpr double epsilon = 1e-9;
+
+    double minThreshold;
+    bool frozen = false;
+    std::vector<std::string> docIDs;
+    std::unordered_map<std::string, uint32_t> ordinals;
+    std::vector<std::vector<std::string>> rawRecords;
+    std::unordered_map<std::string, uint32_t> tokenRanks;
+    std::vector<uint32_t> tokens;
+    std::vector<uint32_t> recordOffsets;
+    std::vector<uint32_t> postingOffsets;
+    std::vector<Posting> postings;
+
+    uint32_t record_size(uint32_t doc) const {
+        return recordOffsets[doc + 1] - recordOffsets[doc];
+    }
+
+    static uint32_t prefix_length(uint32_t size, double threshold) {
+        uint32_t overlap = static_cast<uint32_t>(std::ceil(threshold * size - epsilon));
+        return std::min(size - std::min(overlap, size) + 1, size);
+    }
+
+    static uint32_t required_overlap(uint32_t size1, uint32_t size2, double threshold) {
+        return static_cast<uint32_t>(std::ceil(threshold / (1 + threshold) * (size1 + size2) - epsilon));
+    }
+
+    bool verify(const std::vector<uint32_t>& queryTokens, uint32_t querySize, uint32_t doc, double threshold) const {
+        const uint32_t* first = tokens.data() + recordOffsets[doc];
+        const uint32_t* last = tokens.data() + recordOffsets[doc + 1];
+        uint32_t overlap = 0;
+        auto it = queryTokens.begin();
+        while (it != queryTokens.end() && first != last) {
+            if (*it < *first) {
+                ++it;
+            }
+            else if (*first < *it) {
+                ++first;
+            }
+            else {
+                ++overlap;
+                ++it;
+                ++first;
+            }
+        }
+        uint32_t unionSize = querySize + record_size(doc) - overlap;
+        return unionSize > 0 && static_cast<double>(overlap) / unionSize >= threshold;
+    }
+};
+
+#endif
@@ -6,11 +6,23 @@
 #include <fstream>
 #include <iostream>
 #include "ThreadPool.h"
+#include "StopWords.h"
 #include <unordered_set>
+#include <memory>
+#include <memory_resource>
 #include <tbb/concurrent_unordered_map.h>
 
 using json = nlohmann::json;
 
+// Map built by a single chunk. Its nodes and strings all come from the chunk's own monotonic arena,
+// so nothing is freed piecemeal while the chunk is processed and the whole chunk is released at once
+// after it has been merged.
+template <typename Key, typename Value>
+struct ChunkMap {
+    std::unique_ptr<std::pmr::monotonic_buffer_resource> arena = std::make_unique<std::pmr::monotonic_buffer_resource>(1 << 16);
+    std::pmr::unordered_map<Key, Value> map{arena.get()};
+};
+
 json process_json(const std::string& filename) {
 
     std::ifstream inputFile(filename);
@@ -52,18 +64,9 @@ std::string clean(const std::string& item) {
     return no_parentheses;
 }
 
-std::unordered_map<int, std::vector<std::string>> processChunk(const std::vector<std::string>& lines) {
-    std::unordered_map<int, std::vector<std::string>> localDataMap;
-
-    // Set of words to remove from the ingredients
-    std::unordered_set<std::string> word_set = {"about", "all", "any", "as", "bag", "bell", "bottle", "box", "but", "can", "cans",
-                                                "choice", "coarsely", "cubes", "cut", "dry", "extra", "fine", "finely",
-                                                "for", "free", "freshly", "from", "good", "grams", "i", "if", "in", "inch",
-                                                "into", "is", "jar", "lbs", "like", "more", "none", "not", "of", "on", "one",
-                                                "optional", "other", "ounce", "ounces", "pieces", "pinch", "plain", "plus",
-                                                "possibly", "pound", "pounds", "removed", "size", "slices", "stock", "such", "sweet",
-                                                "t", "tablespoon", "tablespoons", "taste", "teaspoons", "the", "thick", "thin", "thinly",
-                                                "to", "up", "use", "very", "weight", "with", "you", "your"};
+ChunkMap<int, std::pmr::vector<std::pmr::string>> processChunk(const std::vector<std::string>& lines) {
+    ChunkMap<int, std::pmr::vector<std::pmr::string>> localDataMap;
+    std::pmr::memory_resource* arena = localDataMap.arena.get();
 
     for (const auto& line : lines) {
         std::istringstream lineStream(line);
@@ -97,21 +100,20 @@ std::unordered_map<int, std::vector<std::string>> processChunk(const std::vector
             std::transform(ingredient.begin(), ingredient.end(), ingredient.begin(), ::tolower);
             std::istringstream wordStream(ingredient);
             std::string word;
-            std::vector<std::string> cleanedIngredients;
+            std::pmr::string joinedIngredients(arena);
 
             while (wordStream >> word) {
-                if (word_set.find(word) == word_set.end() && !word.empty()) {
-                    cleanedIngredients.push_back(word);
+                if (!word.empty() && !is_ingredient_stop_word(word)) {
+                    if (!joinedIngredients.empty()) {
+                        joinedIngredients += ' ';
+                    }
+                    joinedIngredients += word;
                 }
             }
 
             // If the cleaned ingredient list is not empty, add it to the map
-            if (!cleanedIngredients.empty()) {
-                std::string joinedIngredients = std::accumulate(std::next(cleanedIngredients.begin()), cleanedIngredients.end(), cleanedIngredients[0],
-                                                    [](const std::string& a, const std::string& b) -> std::string { 
-                                                        return a + ' ' + b; 
-                                                    });
-                localDataMap[recipeID].push_back(joinedIngredients);
+            if (!joinedIngredients.empty()) {
+                localDataMap.map[recipeID].push_back(std::move(joinedIngredients));
             }
         }
     }
@@ -120,8 +122,9 @@ std::unordered_map<int, std::vector<std::string>> processChunk(const std::vector
     return localDataMap;
 }
 
-std::unordered_map<std::string, std::vector<std::string>> processLexMaprChunk(const std::vector<std::string>& lines) {
-    std::unordered_map<std::string, std::vector<std::string>> lexMap;
+ChunkMap<std::pmr::string, std::pmr::vector<std::pmr::string>> processLexMaprChunk(const std::vector<std::string>& lines) {
+    ChunkMap<std::pmr::string, std::pmr::vector<std::pmr::string>> lexMap;
+    std::pmr::memory_resource* arena = lexMap.arena.get();
     for (auto& line : lines) {
         std::istringstream lineStream(line);
         std::string id, temp, ingredients, component;
@@ -139,9 +142,10 @@ std::unordered_map<std::string, std::vector<std::string>> processLexMaprChunk(co
             continue;
         }
         recipeID = id;
+        auto& recipeMatches = lexMap.map[std::pmr::string(recipeID.data(), recipeID.size(), arena)];
         
         std::getline(lineStream, temp, ',');
-        lexMap[recipeID].push_back(temp);
+        recipeMatches.emplace_back(temp.data(), temp.size());
 
         std::getline(lineStream, ingredients);
 
@@ -159,7 +163,7 @@ std::unordered_map<std::string, std::vector<std::string>> processLexMaprChunk(co
                     value.pop_back();
                 }
                 if (!value.empty()) {
-                    lexMap[recipeID].push_back(value);
+                    recipeMatches.emplace_back(value.data(), value.size());
                 }
             }
         }
@@ -172,7 +176,7 @@ std::unordered_map<std::string, std::vector<std::string>> processLexMaprChunk(co
 std::unordered_map<std::string, std::vector<std::string>> processCSV(const std::string& filePath, int mode, size_t linesPerChunk = 1000, size_t numThreads = 12) {
     std::ifstream file(filePath);
 
-    std::vector<std::future<std::unordered_map<std::string, std::vector<std::string>>>> futures;
+    std::vector<std::future<ChunkMap<std::pmr::string, std::pmr::vector<std::pmr::string>>>> futures;
 
     ThreadPool pool(numThreads);
     std::vector<std::string> buffer;
@@ -206,8 +210,8 @@ std::unordered_map<std::string, std::vector<std::string>> processCSV(const std::
     // Merge local maps from each thread
     for (auto& fut : futures) {
         auto localMap = fut.get();
-        for (const auto& pair : localMap) {
-            globalDataMap[pair.first] = pair.second;
+        for (const auto& pair : localMap.map) {
+            globalDataMap[std::string(pair.first)] = std::vector<std::string>(pair.second.begin(), pair.second.end());
         }
     }
 
@@ -0,0 +1,347 @@
+#ifndef SHARDEDLSH_H
+#define SHARDEDLSH_H
+
+#include "StaticLSH.h"
+#include "NGram.h"
+#include "util.h"
+#include <string>
+#include <vector>
+#include <thread>
+#include <cstdint>
+#include <cerrno>
+#include <cstdio>
+#include <stdexcept>
+#include <unordered_set>
+#include <tbb/parallel_for.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// Helpers for the length-prefixed messages exchanged with shard workers over pipes.
+bool write_all(int fd, const char* data, size_t size) {
+    while (size > 0) {
+        ssize_t written = ::write(fd, data, size);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        data += written;
+        size -= written;
+    }
+    return true;
+}
+
+bool read_all(int fd, char* data, size_t size) {
+    while (size > 0) {
+        ssize_t received = ::read(fd, data, size);
+        if (received < 0 && errno == EINTR) {
+            continue;
+        }
+        if (received <= 0) {
+            return false;
+        }
+        data += received;
+        size -= received;
+    }
+    return true;
+}
+
+template <typename T>
+void append_value(std::string& buffer, T value) {
+    buffer.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void append_string(std::string& buffer, const std::string& value) {
+    append_value(buffer, static_cast<uint32_t>(value.size()));
+    buffer.append(value);
+}
+
+template <typename T>
+bool read_value(int fd, T& value) {
+    return read_all(fd, reinterpret_cast<char*>(&value), sizeof(value));
+}
+
+bool read_string(int fd, std::string& value) {
+    uint32_t size;
+    if (!read_value(fd, size)) {
+        return false;
+    }
+    value.resize(size);
+    return read_all(fd, &value[0], size);
+}
+
+// Stable across runs and builds, unlike std::hash, so shard files can be reused.
+uint32_t shard_of(const std::string& docID, int numShards) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (char c : docID) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 1099511628211ULL;
+    }
+    return static_cast<uint32_t>(hash % numShards);
+}
+
+std::string shard_filename(const std::string& ontologyPath, int shard, int numShards) {
+    return get_base_filename(ontologyPath) + ".shard" + std::to_string(shard) + "of" + std::to_string(numShards) + ".bin";
+}
+
+// Pins the calling process to the shard's contiguous slice of CPUs, so that with CPUs numbered
+// socket by socket each shard's index stays in the memory local to the socket serving it.
+void pin_shard(int shard, int numShards) {
+    int cpus = static_cast<int>(std::thread::hardware_concurrency());
+    if (cpus < numShards) {
+        return;
+    }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu = shard * cpus / numShards; cpu < (shard + 1) * cpus / numShards; ++cpu) {
+        CPU_SET(cpu, &set);
+    }
+    sched_setaffinity(0, sizeof(set), &set);
+}
+
+// Worker side: loads one shard file and answers query batches from in_fd on out_fd until in_fd is closed.
+// Once loaded, the worker announces the number of documents in its shard. A request is a query count
+// followed by (threshold, minhash signature) pairs; the response holds, per query, the number of
+// matching docIDs followed by the docIDs. Exits non-zero if the shard cannot be loaded.
+int run_shard_worker(const std::string& shardFile, int shard, int numShards, int hash_funcs, int band,
+                     int in_fd = STDIN_FILENO, int out_fd = STDOUT_FILENO) {
+    pin_shard(shard, numShards);
+
+    int status = 0;
+    with_lsh(hash_funcs, band, [&](auto& lsh) {
+        try {
+            if (!lsh.load_from_disk(shardFile)) {
+                status = 1;
+                return;
+            }
+            lsh.freeze();
+        }
+        catch (const std::exception& e) {
+            std::cerr << "Shard " << shard << ": " << e.what() << std::endl;
+            status = 1;
+            return;
+        }
+        std::string ready;
+        append_value(ready, static_cast<uint64_t>(lsh.doc_ids().size()));
+        if (!write_all(out_fd, ready.data(), ready.size())) {
+            status = -1;
+            return;
+        }
+
+        uint32_t count;
+        while (read_value(in_fd, count)) {
+            std::vector<double> thresholds(count);
+            std::vector<std::vector<unsigned long>> signatures(count, std::vector<unsigned long>(hash_funcs));
+            for (uint32_t i = 0; i < count; ++i) {
+                if (!read_value(in_fd, thresholds[i])
+                    || !read_all(in_fd, reinterpret_cast<char*>(signatures[i].data()), hash_funcs * sizeof(unsigned long))) {
+                    std::cerr << "Shard " << shard << " received a truncated batch" << std::endl;
+                    status = -1;
+                    return;
+                }
+            }
+
+            std::vector<std::unordered_set<std::string>> results(count);
+            tbb::parallel_for(static_cast<uint32_t>(0), count, [&](uint32_t i) {
+                results[i] = lsh.query_signature(signatures[i], thresholds[i]);
+            });
+
+            std::string response;
+            for (const auto& result : results) {
+                append_value(response, static_cast<uint32_t>(result.size()));
+                for (const auto& docID : result) {
+                    append_string(response, docID);
+                }
+            }
+            if (!write_all(out_fd, response.data(), response.size())) {
+                status = -1;
+                return;
+            }
+        }
+    });
+    return status;
+}
+
+// Coordinator side: the ontology is partitioned by docID hash into numShards index files, each served
+// by a local worker process. Query signatures are computed once here, sent in batches to every worker,
+// and the per-shard results merged.
+class ShardedLSH {
+public:
+    ShardedLSH(int numShards, int numBands, int numHashes, int n = 3)
+        : numShards(numShards), numBands(numBands), numHashes(numHashes), n(n) {
+        for (int i = 0; i < numHashes; ++i) {
+            hashFuncs.emplace_back(i);
+        }
+    }
+
+    ~ShardedLSH() {
+        stop();
+    }
+
+    // Builds the shard files unless all of them already exist. Shards are built concurrently, one thread each.
+    // Throws if a shard would be empty or cannot be written.
+    void build(const std::vector<std::string>& ontologies, const std::string& ontologyPath) {
+        bool complete = true;
+        for (int shard = 0; shard < numShards; ++shard) {
+            complete = complete && file_exists(shard_filename(ontologyPath, shard, numShards));
+        }
+        if (complete) {
+            return;
+        }
+
+        std::vector<std::vector<std::string>> partitions(numShards);
+        for (const auto& label : ontologies) {
+            partitions[shard_of(label, numShards)].push_back(label);
+        }
+
+        for (int shard = 0; shard < numShards; ++shard) {
+            if (partitions[shard].empty()) {
+                throw std::runtime_error("Shard " + std::to_string(shard) + " of " + std::to_string(numShards) + " would be empty");
+            }
+        }
+
+        std::vector<char> saved(numShards, 0);
+        std::vector<std::thread> builders;
+        for (int shard = 0; shard < numShards; ++shard) {
+            builders.emplace_back([&, shard] {
+                LSH lsh(numBands, numHashes);
+                for (const auto& label : partitions[shard]) {
+                    lsh.insert(text_to_ngrams(label, n), label);
+                }
+                saved[shard] = lsh.save_to_disk(shard_filename(ontologyPath, shard, numShards));
+            });
+        }
+        for (auto& builder : builders) {
+            builder.join();
+        }
+        for (int shard = 0; shard < numShards; ++shard) {
+            if (!saved[shard]) {
+                std::remove(shard_filename(ontologyPath, shard, numShards).c_str());
+                throw std::runtime_error("Failed to write shard file " + shard_filename(ontologyPath, shard, numShards));
+            }
+        }
+    }
+
+    // Starts one worker process per shard by re-executing this binary in worker mode, and waits until
+    // each has loaded its shard. Throws if a worker fails to load or loads an empty shard.
+    void start(const std::string& ontologyPath) {
+        signal(SIGPIPE, SIG_IGN);
+        for (int shard = 0; shard < numShards; ++shard) {
+            int toWorker[2], fromWorker[2];
+            if (pipe2(toWorker, O_CLOEXEC) != 0 || pipe2(fromWorker, O_CLOEXEC) != 0) {
+                throw std::runtime_error("Failed to create shard pipes");
+            }
+
+            std::vector<std::string> args = {"EntityMatching", "--shard-worker", shard_filename(ontologyPath, shard, numShards),
+                                             std::to_string(shard), std::to_string(numShards), std::to_string(numHashes),
+                                             std::to_string(numBands)};
+            std::vector<char*> argv;
+            for (auto& arg : args) {
+                argv.push_back(&arg[0]);
+            }
+            argv.push_back(nullptr);
+
+            pid_t pid = fork();
+            if (pid == 0) {
+                dup2(toWorker[0], STDIN_FILENO);
+                dup2(fromWorker[1], STDOUT_FILENO);
+                execv("/proc/self/exe", argv.data());
+                _exit(127);
+            }
+            close(toWorker[0]);
+            close(fromWorker[1]);
+            if (pid < 0) {
+                close(toWorker[1]);
+                close(fromWorker[0]);
+                throw std::runtime_error("Failed to start shard worker");
+            }
+            workers.push_back(Worker{pid, toWorker[1], fromWorker[0]});
+        }
+
+        for (int shard = 0; shard < numShards; ++shard) {
+            uint64_t documents = 0;
+            if (!read_value(workers[shard].out, documents)) {
+                throw std::runtime_error("Shard worker " + std::to_string(shard) + " failed to load "
+                                         + shard_filename(ontologyPath, shard, numShards));
+            }
+            if (documents == 0) {
+                throw std::runtime_error("Shard worker " + std::to_string(shard) + " loaded an empty index from "
+                                         + shard_filename(ontologyPath, shard, numShards));
+            }
+        }
+    }
+
+    // Sends the batch to every shard, then collects and merges their answers.
+    std::vector<std::unordered_set<std::string>> query_batch(const std::vector<std::string>& phrases,
+                                                             const std::vector<double>& thresholds) {
+        std::vector<std::vector<unsigned long>> signatures(phrases.size());
+        tbb::parallel_for(static_cast<size_t>(0), phrases.size(), [&](size_t i) {
+            signatures[i] = minhash(text_to_ngrams(phrases[i], n), hashFuncs);
+        });
+
+        std::string request;
+        append_value(request, static_cast<uint32_t>(phrases.size()));
+        for (size_t i = 0; i < phrases.size(); ++i) {
+            append_value(request, thresholds[i]);
+            request.append(reinterpret_cast<const char*>(signatures[i].data()), signatures[i].size() * sizeof(unsigned long));
+        }
+        for (auto& worker : workers) {
+            if (!write_all(worker.in, request.data(), request.size())) {
+                throw std::runtime_error("Failed to send batch to shard worker");
+            }
+        }
+
+        std::vector<std::unordered_set<std::string>> results(phrases.size());
+        std::string docID;
+        for (auto& worker : workers) {
+            for (auto& result : results) {
+                uint32_t count;
+                if (!read_value(worker.out, count)) {
+                    throw std::runtime_error("Shard worker exited before answering");
+                }
+                for (uint32_t k = 0; k < count; ++k) {
+                    if (!read_string(worker.out, docID)) {
+                        throw std::runtime_error("Shard worker exited before answering");
+                    }
+                    result.insert(docID);
+                }
+            }
+        }
+        return results;
+    }
+
+    // Closing the request pipes tells the workers to exit. Returns false if any of them exited abnormally.
+    bool stop() {
+        bool clean = true;
+        for (auto& worker : workers) {
+            close(worker.in);
+            close(worker.out);
+            int status = 0;
+            if (waitpid(worker.pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+                clean = false;
+            }
+        }
+        workers.clear();
+        return clean;
+    }
+
+private:
+    struct Worker {
+        pid_t pid;
+        int in;
+        int out;
+    };
+
+    int numShards;
+    int numBands;
+    int numHashes;
+    int n;
+    std::vector<HashFunc> hashFuncs;
+    std::vector<Worker> workers;
+};
+
+#endif
@@ -0,0 +1,129 @@
+#ifndef STATICLSH_H
+#define STATICLSH_H
+
+#include "LSH.h"
+#include <array>
+#include <charconv>
+#include <stdexcept>
+
+// LSH with the band/row configuration fixed at compile time. Building, loading, saving and
+// freezing are shared with LSH; once frozen, queries run with fixed-length minhash, band hashing
+// and verification kernels. The inheritance is protected so that the LSH query methods, which
+// StaticLSH hides rather than overrides, cannot be reached through an LSH&.
+template <int Bands, int Rows>
+class StaticLSH : protected LSH {
+public:
+    using LSH::insert;
+    using LSH::insert_signature;
+    using LSH::fit_idf;
+    using LSH::is_weighted;
+    using LSH::is_frozen;
+    using LSH::num_hashes;
+    using LSH::doc_ids;
+    using LSH::compute_signature;
+    using LSH::save_to_disk;
+    using LSH::load_from_disk;
+
+    static constexpr size_t SignatureLength = Bands * Rows;
+    using Signature = std::array<unsigned long, SignatureLength>;
+
+    StaticLSH() : LSH(Bands, Bands * Rows) {}
+
+    void freeze() {
+        if (frozen) {
+            return;
+        }
+        LSH::freeze();
+        if (numBands != Bands || bandSize != Rows || (!docIDs.empty() && sigLength != SignatureLength)) {
+            throw std::runtime_error("LSH index does not match StaticLSH configuration");
+        }
+    }
+
+    std::unordered_set<std::string> query(const std::vector<std::string>& queryNgrams, double threshold = 0.4,
+                                          size_t* candidateCount = nullptr) {
+        if (!frozen) {
+            return LSH::query(queryNgrams, threshold, candidateCount);
+        }
+
+        if (weighted) {
+            return query_fixed(compute_signature(queryNgrams).data(), threshold, candidateCount);
+        }
+        Signature querySignature = minhash<SignatureLength>(queryNgrams, hashFuncs);
+        return query_fixed(querySignature.data(), threshold, candidateCount);
+    }
+
+    std::unordered_set<std::string> query_signature(const std::vector<unsigned long>& querySignature, double threshold = 0.4,
+                                                    size_t* candidateCount = nullptr) {
+        if (!frozen) {
+            return LSH::query_signature(querySignature, threshold, candidateCount);
+        }
+        if (querySignature.size() != SignatureLength) {
+            throw std::runtime_error("Signature length does not match StaticLSH configuration");
+        }
+        return query_fixed(querySignature.data(), threshold, candidateCount);
+    }
+
+    // Same as LSH::query_ordinals, with the fixed-length band key and verification kernel.
+    std::vector<uint32_t> query_ordinals(const unsigned long* querySignature, double threshold, size_t* candidateCount = nullptr) const {
+        if (!frozen) {
+            throw std::runtime_error("query_ordinals on unfrozen LSH");
+        }
+
+        size_t required = required_matches(SignatureLength, threshold);
+        return collect_ordinals(
+            [&](int band) { return computeBandKey(querySignature, band); },
+            [&](const unsigned long* docSignature) { return matches_at_least_fixed<SignatureLength>(querySignature, docSignature, required); },
+            candidateCount);
+    }
+
+private:
+    std::unordered_set<std::string> query_fixed(const unsigned long* querySignature, double threshold, size_t* candidateCount) const {
+        std::unordered_set<std::string> result;
+        for (uint32_t ordinal : query_ordinals(querySignature, threshold, candidateCount)) {
+            result.insert(docIDs[ordinal]);
+        }
+        return result;
+    }
+
+    // Formats the band's rows exactly as LSH::computeBandKey does, without going through a stream.
+    static uint64_t computeBandKey(const unsigned long* signature, int band) {
+        char buffer[Rows * 20];
+        char* end = buffer;
+        for (int i = 0; i < Rows; ++i) {
+            end = std::to_chars(end, buffer + sizeof(buffer), signature[band * Rows + i]).ptr;
+        }
+
+        unsigned char hash[SHA_DIGEST_LENGTH];
+        SHA1(reinterpret_cast<const unsigned char*>(buffer), end - buffer, hash);
+
+        uint64_t key = 0;
+        for (int i = 0; i < 8; ++i) {
+            key = (key << 8) | hash[i];
+        }
+        return key;
+    }
+};
+
+// Use a compile-time specialized index for the configurations we deploy with,
+// and fall back to the runtime LSH for anything else.
+template <typename Func>
+void with_lsh(int hash_funcs, int band, Func&& func) {
+    if (hash_funcs == 100 && band == 25) {
+        StaticLSH<25, 4> lsh;
+        func(lsh);
+    }
+    else if (hash_funcs == 100 && band == 20) {
+        StaticLSH<20, 5> lsh;
+        func(lsh);
+    }
+    else if (hash_funcs == 100 && band == 50) {
+        StaticLSH<50, 2> lsh;
+        func(lsh);
+    }
+    else {
+        LSH lsh(band, hash_funcs);
+        func(lsh);
+    }
+}
+
+#endif
@@ -0,0 +1,170 @@
+#ifndef STOPWORDS_H
+#define STOPWORDS_H
+
+#include <array>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <cstdint>
+
+// Builds a word list whose size is deduced from the number of words, so lists can be edited freely.
+template <typename... Words>
+constexpr std::array<std::string_view, sizeof...(Words)> make_array(const Words&... words) {
+    return {std::string_view(words)...};
+}
+
+// Words removed from every phrase before matching.
+constexpr auto general_stop_word_list = make_array(
+    "about", "all", "any", "as", "but", "can",
+    "choice", "extra", "for", "free", "from", "good", "i", "if", "in", "inch",
+    "into", "is", "like", "more", "none", "not", "of", "on", "one",
+    "optional", "other", "pieces", "plus", "possibly", "removed", "size", "such",
+    "the", "to", "up", "use", "very", "weight", "with", "you", "your");
+
+// Packaging, measurement and preparation words that are also removed from raw recipe ingredients.
+constexpr auto ingredient_stop_word_list = make_array(
+    "bag", "bell", "bottle", "box", "cans", "coarsely", "cubes", "cut", "dry", "fine", "finely",
+    "freshly", "grams", "jar", "lbs", "ounce", "ounces", "pinch", "plain", "pound", "pounds",
+    "slices", "stock", "sweet", "t", "tablespoon", "tablespoons", "taste", "teaspoons", "thick",
+    "thin", "thinly");
+
+constexpr uint64_t stop_word_hash(std::string_view word, uint64_t seed) {
+    uint64_t hash = 14695981039346656037ULL ^ (seed * 0x9E3779B97F4A7C15ULL);
+    for (char c : word) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 1099511628211ULL;
+    }
+    // Finalizer from MurmurHash3, so that short words differ in the low bits used for slots.
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ULL;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+template <size_t N, size_t M>
+constexpr std::array<std::string_view, N + M> concat(const std::array<std::string_view, N>& a, const std::array<std::string_view, M>& b) {
+    std::array<std::string_view, N + M> result{};
+    for (size_t i = 0; i < N; ++i) {
+        result[i] = a[i];
+    }
+    for (size_t i = 0; i < M; ++i) {
+        result[N + i] = b[i];
+    }
+    return result;
+}
+
+// Perfect hash over a fixed word list, built at compile time by searching for a seed that
+// places every word in its own slot. A lookup is one hash and at most one string compare.
+template <size_t N, size_t TableSize>
+class StaticStopWords {
+    static_assert((TableSize & (TableSize - 1)) == 0, "TableSize must be a power of two");
+    static_assert(TableSize >= 2 * N, "TableSize too small for a perfect hash");
+
+public:
+    constexpr StaticStopWords(const std::array<std::string_view, N>& words) : seed(0), slots{} {
+        while (!place(words)) {
+            ++seed;
+        }
+    }
+
+    constexpr bool contains(std::string_view word) const {
+        std::string_view slot = slots[stop_word_hash(word, seed) & (TableSize - 1)];
+        return !slot.empty() && slot == word;
+    }
+
+private:
+    uint64_t seed;
+    std::array<std::string_view, TableSize> slots;
+
+    constexpr bool place(const std::array<std::string_view, N>& words) {
+        for (size_t i = 0; i < TableSize; ++i) {
+            slots[i] = std::string_view();
+        }
+        for (size_t i = 0; i < N; ++i) {
+            std::string_view& slot = slots[stop_word_hash(words[i], seed) & (TableSize - 1)];
+            if (!slot.empty() && slot != words[i]) {
+                return false;
+            }
+            slot = words[i];
+        }
+        return true;
+    }
+};
+
+constexpr StaticStopWords<general_stop_word_list.size(), 256> stop_words(general_stop_word_list);
+constexpr StaticStopWords<general_stop_word_list.size() + ingredient_stop_word_list.size(), 512> ingredient_stop_words(
+    concat(general_stop_word_list, ingredient_stop_word_list));
+
+static_assert(stop_words.contains("the") && !stop_words.contains("tomato"));
+static_assert(ingredient_stop_words.contains("tablespoons") && ingredient_stop_words.contains("the"));
+
+// Domain stop words loaded at runtime. Uses the same hash in an open-addressing table kept at most
+// a quarter full, so lookups stay at about one probe.
+class StopWords {
+public:
+    bool load(const std::string& filename) {
+        std::ifstream inFile(filename);
+        if (!inFile.is_open()) {
+            std::cerr << "Failed to open " << filename << std::endl;
+            return false;
+        }
+
+        std::string word;
+        while (inFile >> word) {
+            std::transform(word.begin(), word.end(), word.begin(), ::tolower);
+            words.push_back(word);
+        }
+        build();
+        return true;
+    }
+
+    bool contains(std::string_view word) const {
+        if (slots.empty()) {
+            return false;
+        }
+        size_t mask = slots.size() - 1;
+        for (size_t slot = stop_word_hash(word, 0) & mask; !slots[slot].empty(); slot = (slot + 1) & mask) {
+            if (slots[slot] == word) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+private:
+    std::vector<std::string> words;
+    std::vector<std::string_view> slots;
+
+    void build() {
+        size_t capacity = 16;
+        while (capacity < words.size() * 4) {
+            capacity <<= 1;
+        }
+        slots.assign(capacity, std::string_view());
+
+        for (const auto& word : words) {
+            size_t slot = stop_word_hash(word, 0) & (capacity - 1);
+            while (!slots[slot].empty() && slots[slot] != word) {
+                slot = (slot + 1) & (capacity - 1);
+            }
+            slots[slot] = word;
+        }
+    }
+};
+
+StopWords domain_stop_words;
+
+bool is_stop_word(std::string_view word) {
+    return stop_words.contains(word) || domain_stop_words.contains(word);
+}
+
+bool is_ingredient_stop_word(std::string_view word) {
+    return ingredient_stop_words.contains(word) || domain_stop_words.contains(word);
+}
+
+#endif
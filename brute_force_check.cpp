@@ -0,0 +1,149 @@
+// Checks PrefixJoin and the signature comparison kernels against brute force on random inputs.
+// Built and run by `make check`; exits non-zero on the first mismatch.
+
+#include "MinHash.h"
+#include "PrefixJoin.h"
+
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+#include <unordered_set>
+#include <iostream>
+
+static std::mt19937 rng(42);
+
+static std::vector<std::string> random_ngrams(size_t maxSize, int alphabet) {
+    std::vector<std::string> ngrams(std::uniform_int_distribution<size_t>(0, maxSize)(rng));
+    for (auto& ngram : ngrams) {
+        ngram = "g" + std::to_string(std::uniform_int_distribution<int>(0, alphabet - 1)(rng));
+    }
+    return ngrams;
+}
+
+static double exact_jaccard(const std::vector<std::string>& a, const std::vector<std::string>& b) {
+    std::set<std::string> x(a.begin(), a.end()), y(b.begin(), b.end());
+    size_t overlap = 0;
+    for (const auto& token : x) {
+        overlap += y.count(token);
+    }
+    size_t unionSize = x.size() + y.size() - overlap;
+    return unionSize ? static_cast<double>(overlap) / unionSize : 0;
+}
+
+static bool check_prefix_join() {
+    const double minThreshold = 0.3;
+    const std::vector<double> thresholds = {0.1, 0.2, 0.3, 0.4, 0.5, 0.6, 0.75, 0.8, 0.9, 1.0};
+
+    for (int round = 0; round < 20; ++round) {
+        int alphabet = 5 + round * 3;
+        std::vector<std::vector<std::string>> records(300);
+        PrefixJoin index(minThreshold);
+        for (size_t doc = 0; doc < records.size(); ++doc) {
+            records[doc] = random_ngrams(12, alphabet);
+            index.insert(records[doc], std::to_string(doc));
+        }
+        index.freeze();
+
+        for (int q = 0; q < 50; ++q) {
+            // Half of the queries are perturbed copies of indexed records, so high thresholds are hit too.
+            std::vector<std::string> query = random_ngrams(12, alphabet);
+            if (q % 2) {
+                query = records[std::uniform_int_distribution<size_t>(0, records.size() - 1)(rng)];
+                if (!query.empty() && q % 4 == 1) {
+                    query.pop_back();
+                }
+                query.push_back("g" + std::to_string(alphabet));
+            }
+            for (double threshold : thresholds) {
+                std::unordered_set<std::string> expected;
+                for (size_t doc = 0; doc < records.size(); ++doc) {
+                    if (exact_jaccard(query, records[doc]) >= threshold) {
+                        expected.insert(std::to_string(doc));
+                    }
+                }
+                if (index.query(query, threshold) != expected) {
+                    std::cerr << "PrefixJoin mismatch: round " << round << ", query " << q << ", threshold " << threshold << std::endl;
+                    return false;
+                }
+            }
+        }
+    }
+    std::cout << "PrefixJoin: ok" << std::endl;
+    return true;
+}
+
+static bool naive_matches_at_least(const unsigned long* s1, const unsigned long* s2, size_t length, size_t required) {
+    size_t matches = 0;
+    for (size_t i = 0; i < length; ++i) {
+        matches += s1[i] == s2[i];
+    }
+    return matches >= required;
+}
+
+// Pairs of signatures whose slots agree with the given probability, compared at every required count.
+template <typename Kernel>
+static bool check_kernel(const char* name, Kernel kernel, size_t length) {
+    std::vector<unsigned long> s1(length), s2(length);
+    for (double agreement : {0.0, 0.1, 0.5, 0.9, 1.0}) {
+        for (int pair = 0; pair < 20; ++pair) {
+            for (size_t i = 0; i < length; ++i) {
+                s1[i] = rng();
+                s2[i] = std::bernoulli_distribution(agreement)(rng) ? s1[i] : s1[i] + 1;
+            }
+            for (size_t required = 0; required <= length + 1; ++required) {
+                if (kernel(s1.data(), s2.data(), length, required) != naive_matches_at_least(s1.data(), s2.data(), length, required)) {
+                    std::cerr << name << " mismatch: length " << length << ", required " << required << std::endl;
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+template <size_t Length>
+static bool check_fixed_kernels() {
+    auto fixed = [](FixedMatchKernel kernel) {
+        return [kernel](const unsigned long* s1, const unsigned long* s2, size_t, size_t required) {
+            return kernel(s1, s2, required);
+        };
+    };
+    bool ok = check_kernel("matches_at_least_fixed_scalar", fixed(matches_at_least_fixed_scalar<Length>), Length);
+#if defined(__x86_64__)
+    if (__builtin_cpu_supports("sse4.1")) {
+        ok = ok && check_kernel("matches_at_least_fixed_sse41", fixed(matches_at_least_fixed_sse41<Length>), Length);
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        ok = ok && check_kernel("matches_at_least_fixed_avx2", fixed(matches_at_least_fixed_avx2<Length>), Length);
+    }
+#endif
+    return ok;
+}
+
+static bool check_kernels() {
+    for (size_t length = 1; length <= 200; ++length) {
+        if (!check_kernel("matches_at_least_scalar", matches_at_least_scalar, length)) {
+            return false;
+        }
+#if defined(__x86_64__)
+        if (__builtin_cpu_supports("sse4.1") && !check_kernel("matches_at_least_sse41", matches_at_least_sse41, length)) {
+            return false;
+        }
+        if (__builtin_cpu_supports("avx2") && !check_kernel("matches_at_least_avx2", matches_at_least_avx2, length)) {
+            return false;
+        }
+#endif
+    }
+    if (!check_fixed_kernels<7>() || !check_fixed_kernels<20>() || !check_fixed_kernels<100>()) {
+        return false;
+    }
+    std::cout << "matches_at_least kernels: ok" << std::endl;
+    return true;
+}
+
+int main() {
+    bool ok = check_kernels();
+    ok = check_prefix_join() && ok;
+    return ok ? 0 : 1;
+}
@@ -1,20 +1,23 @@
 #include "LSH_Wrapper.h"
 #include "LSH.h"
+#include "StaticLSH.h"
+#include "PrefixJoin.h"
+#include "ShardedLSH.h"
 #include "ReadFile.h"
 #include "NGram.h"
 #include "Memory_Usage.h"
 #include "util.h"
+#include "StopWords.h"
+#include "Evaluation.h"
 #include <chrono>
 #include <unordered_set>
 #include <future>
 #include <cmath>
+#include <cstdio>
+#include <memory_resource>
 #include <tbb/concurrent_unordered_map.h>
+#include <tbb/parallel_for.h>
 
-std::unordered_set<std::string> word_set = {"about", "all", "any", "as", "but", "can",
-                                            "choice", "extra", "for", "free", "from", "good", "i", "if", "in", "inch",
-                                            "into", "is", "like", "more", "none", "not", "of", "on", "one",
-                                            "optional", "other", "pieces", "plus", "possibly", "removed", "size", "such",
-                                            "the", "to", "up", "use", "very", "weight", "with", "you", "your"};
 std::queue<std::pair<std::string, std::vector<std::string>>> tasks;
 tbb::concurrent_unordered_map<std::string, std::string> inverted_index;
 tbb::concurrent_unordered_map<std::string, std::unordered_set<std::string>> cache;
@@ -26,51 +29,29 @@ tbb::concurrent_unordered_map<std::string, std::unordered_set<std::string>> inve
 std::unordered_map<std::string, std::unordered_set<std::string>> matches;
 std::mutex mutex;
 
-std::vector<std::string> filter_string(const std::string& input_string) {
-    std::istringstream iss(input_string);
-    std::vector<std::string> words;
-    std::string word;
-
-    std::string filtered_word;
-
-    while (iss >> word) {
-        filtered_word.clear();
-        for (char ch : word) {
-            if (std::isalpha(ch) || std::isspace(ch)) {
-                filtered_word += std::tolower(ch);
-            }
-        }
-        if (filtered_word.empty()) {
-            continue;
-        }
-        if (word_set.find(filtered_word) == word_set.end()) {
-            words.push_back(std::move(filtered_word));
-            filtered_word = std::string();
-        }
-    }
-    return words;
-}
-
 void process_chunk_words(
     const std::unordered_map<std::string, std::string>::iterator& start,
     const std::unordered_map<std::string, std::string>::iterator& end, int thread_id) {
 
-    std::unordered_map<std::string, std::unordered_set<std::string>> local_index_multiple;
-    std::unordered_map<std::string, std::unordered_set<std::string>> local_index_single;
+    // Every node and string of the thread-local indexes comes from this arena and is released in one step.
+    std::pmr::monotonic_buffer_resource arena(1 << 20);
+    std::pmr::unordered_map<std::pmr::string, std::pmr::unordered_set<std::pmr::string>> local_index_multiple(&arena);
+    std::pmr::unordered_map<std::pmr::string, std::pmr::unordered_set<std::pmr::string>> local_index_single(&arena);
 
     int completed_tasks = 0;
 
     for (auto it = start; it != end; ++it) {
         auto filtered_string = filter_string(it->second);
         auto words = text_to_ngrams_words(filtered_string, 2);
+        std::pmr::string recipeID(it->first.data(), it->first.size(), &arena);
 
         for (const auto& w : words) {
-            local_index_multiple[w].insert(it->first);
+            local_index_multiple[std::pmr::string(w.data(), w.size(), &arena)].insert(recipeID);
         }
 
         auto single_words = text_to_ngrams_words(filtered_string, 1);
         for (const auto& w : single_words) {
-            local_index_single[w].insert(it->first);
+            local_index_single[std::pmr::string(w.data(), w.size(), &arena)].insert(recipeID);
         }
         completed_tasks++;
         if (completed_tasks % 10000 == 0) {
@@ -80,61 +61,64 @@ void process_chunk_words(
 
     std::lock_guard<std::mutex> lock(mutex);
     for (const auto& [key, value] : local_index_multiple) {
-        inverted_index_multiple[key].insert(value.begin(), value.end());
+        auto& recipes = inverted_index_multiple[std::string(key)];
+        for (const auto& recipeID : value) {
+            recipes.emplace(recipeID);
+        }
     }
-    local_index_multiple.clear();
     for (const auto& [key, value] : local_index_single) {
-        inverted_index_single[key].insert(value.begin(), value.end());
+        auto& recipes = inverted_index_single[std::string(key)];
+        for (const auto& recipeID : value) {
+            recipes.emplace(recipeID);
+        }
     }
-    local_index_single.clear();
 }
 
+template <typename Index>
 void process_chunk(int thread_id, const std::vector<std::pair<std::string, std::string>>& tasks,
-                   LSH& lsh, int n){
+                   Index& lsh, int n){
     int completedTasks = 0;
-    std::unordered_map<std::string, std::unordered_set<std::string>> local_mismatch;
-    std::unordered_map<std::string, std::unordered_set<std::string>> local_ingredients_matches;
+    std::pmr::monotonic_buffer_resource arena(1 << 20);
+    std::pmr::unordered_map<std::pmr::string, std::pmr::unordered_set<std::pmr::string>> local_ingredients_matches(&arena);
     for (int i = 0; i < tasks.size(); ++i) {
         const auto& task = tasks[i];
-        auto key = std::get<0>(task);
-        std::unordered_set<std::string> set;
-        auto indicator = std::get<1>(task);
-        if (indicator == "single") {
-            auto candidates = lsh.query(text_to_ngrams(key, n), 0.9);
-            set.insert(candidates.begin(), candidates.end());
-        }
-        else {
-            auto candidates = lsh.query(text_to_ngrams(key, n), 0.5);
-            set.insert(candidates.begin(), candidates.end());
-        }
+        const auto& key = std::get<0>(task);
+        const auto& indicator = std::get<1>(task);
+        auto candidates = lsh.query(text_to_ngrams(key, n), indicator == "single" ? 0.9 : 0.5);
 
-        local_ingredients_matches[key].insert(set.begin(), set.end());
+        auto& local_matches = local_ingredients_matches[std::pmr::string(key.data(), key.size(), &arena)];
+        for (const auto& candidate : candidates) {
+            local_matches.emplace(candidate);
+        }
 
         completedTasks++;
     }
 
-    for (auto& pair : local_ingredients_matches) {
-        ingredients_matches[pair.first].insert(pair.second.begin(), pair.second.end());
+    for (auto& [key, value] : local_ingredients_matches) {
+        auto& recipe_matches = ingredients_matches[std::string(key)];
+        for (const auto& candidate : value) {
+            recipe_matches.emplace(candidate);
+        }
     }
 }
 
-void match(std::string ontologyPath, std::string ingredientPath, std::string outputPath, int hash_funcs = 100, int band = 25) {
-    LSH lsh(band, hash_funcs);
-    std::string filename = outputPath;
-    std::unordered_map<std::string, std::pair<std::string, std::string>> index;
-    int n = 3;
-    tbb::concurrent_unordered_map<std::string, std::unordered_set<std::string>> cache;
-
+// Parses the ontology JSON. Returns the ontology labels to index.
+std::vector<std::string> load_ontology(const std::string& ontologyPath,
+                                       std::unordered_map<std::string, std::pair<std::string, std::string>>& index) {
     json json = process_json(ontologyPath);
+    return parseJson(json, index, inverted_index);
+}
+
+// Parses the candidate CSV and fills the phrase indexes.
+void load_candidates(const std::string& ingredientPath,
+                     std::unordered_map<std::string, std::unordered_set<std::string>>& possible_matches) {
     std::unordered_map<std::string, std::vector<std::string>> lexMaprIngredients = processCSV(ingredientPath, 1);
-    std::unordered_map<std::string, std::unordered_set<std::string>> possible_matches;
     std::unordered_map<std::string, std::string> ingredients;
     for (auto& [key, value] : lexMaprIngredients) {
         ingredients[key] = value[0];
         possible_matches[key].insert(value.begin() + 1, value.end());
     }
     lexMaprIngredients.clear();
-    std::vector<std::string> ontologies = parseJson(json, index, inverted_index);
 
     const size_t max_concurrent_tasks = std::min(std::thread::hardware_concurrency(), static_cast<unsigned int>(ingredients.size()));
     std::vector<std::thread> threads;
@@ -151,18 +135,9 @@ void match(std::string ontologyPath, std::string ingredientPath, std::string out
     for (auto& t : threads) {
         t.join();
     }
+}
 
-    std::string bin_filename = get_base_filename(ontologyPath) + ".bin";
-    if (file_exists(bin_filename)) {
-        lsh.load_from_disk(bin_filename);
-    }
-    else {
-        for (int i = 0; i < ontologies.size(); ++i) {
-            lsh.insert(text_to_ngrams(ontologies[i], n), ontologies[i]);
-        }
-        lsh.save_to_disk(bin_filename);
-    }
-    
+std::vector<std::pair<std::string, std::string>> build_tasks() {
     std::vector<std::pair<std::string, std::string>> tasks;
     
     for (auto& [key, value] : inverted_index_multiple) {
@@ -172,6 +147,114 @@ void match(std::string ontologyPath, std::string ingredientPath, std::string out
     for (auto& [key, value] : inverted_index_single) {
         tasks.push_back({key, "single"});
     }
+    return tasks;
+}
+
+// Inserts the ontology labels, fitting the n-gram IDF weights over them first when weighted.
+template <typename Index>
+void index_ontology(Index& lsh, const std::vector<std::string>& labels, int n, bool weighted = false) {
+    std::vector<std::vector<std::string>> documents;
+    for (size_t i = 0; i < labels.size(); ++i) {
+        documents.push_back(text_to_ngrams(labels[i], n));
+    }
+    if (weighted) {
+        lsh.fit_idf(documents);
+    }
+    for (size_t i = 0; i < labels.size(); ++i) {
+        lsh.insert(documents[i], labels[i]);
+    }
+}
+
+// LSH indexes are cached next to the ontology as a .bin file (.idf.bin when TF-IDF weighted). A cached
+// index is loaded without waiting for the ontology labels; they are only needed to build a new one,
+// which also replaces a cache file that cannot be loaded.
+template <typename Index>
+void build_index(Index& lsh, std::shared_future<std::vector<std::string>> ontologies, const std::string& ontologyPath, int n,
+                 bool weighted = false) {
+    std::string bin_filename = get_base_filename(ontologyPath) + (weighted ? ".idf.bin" : ".bin");
+    if (!file_exists(bin_filename) || !lsh.load_from_disk(bin_filename)) {
+        index_ontology(lsh, ontologies.get(), n, weighted);
+        if (!lsh.save_to_disk(bin_filename)) {
+            std::remove(bin_filename.c_str());
+            std::cerr << "Index not cached; it will be rebuilt next run" << std::endl;
+        }
+    }
+    lsh.freeze();
+}
+
+// The prefix-filtering index needs no hashing and is rebuilt from the ontology every run.
+// It computes exact unweighted Jaccard, so weighting does not apply.
+void build_index(PrefixJoin& join, std::shared_future<std::vector<std::string>> ontologies, const std::string& ontologyPath, int n,
+                 bool weighted = false) {
+    const auto& labels = ontologies.get();
+    for (size_t i = 0; i < labels.size(); ++i) {
+        join.insert(text_to_ngrams(labels[i], n), labels[i]);
+    }
+    join.freeze();
+}
+
+// Maps each recipe to the ontology labels matched by any of its phrases.
+template <typename PhraseMatches>
+std::unordered_map<std::string, std::unordered_set<std::string>> collect_matches(const PhraseMatches& phrase_matches) {
+    std::unordered_map<std::string, std::unordered_set<std::string>> matches;
+    for (auto& [key, value] : phrase_matches) {
+        auto multiple = inverted_index_multiple.find(key);
+        auto single = inverted_index_single.find(key);
+        if (multiple != inverted_index_multiple.end()) {
+            for (auto& element : multiple->second) {
+                matches[element].insert(value.begin(), value.end());
+            }
+        }
+        else if (single != inverted_index_single.end()) {
+            for (auto& element : single->second) {
+                matches[element].insert(value.begin(), value.end());
+            }
+        }
+    }
+    return matches;
+}
+
+std::unordered_map<std::string, std::unordered_set<std::string>> collect_matches() {
+    return collect_matches(ingredients_matches);
+}
+
+void write_matches(const std::string& filename, const std::unordered_map<std::string, std::unordered_set<std::string>>& matches,
+                   std::unordered_map<std::string, std::pair<std::string, std::string>>& index) {
+    std::ofstream outFile(filename);
+
+    if (!outFile.is_open()) {
+        std::cerr << "Failed to open " << filename << std::endl;
+        return;
+    }
+
+    for (auto& [key, value] : matches) {
+        outFile << key << std::endl;
+        for (auto& v : value) {
+            outFile << "(" << index[v].first << " " << index[v].second << "), ";
+        }
+        outFile << "\n";
+    }
+}
+
+template <typename Index>
+void run_match(Index& lsh, std::string ontologyPath, std::string ingredientPath, std::string outputPath, bool weighted = false) {
+    std::string filename = outputPath;
+    std::unordered_map<std::string, std::pair<std::string, std::string>> index;
+    int n = 3;
+
+    std::unordered_map<std::string, std::unordered_set<std::string>> possible_matches;
+
+    // The ontology stage (JSON parse, then index load or build) runs alongside the CSV stage
+    // (CSV parse, then phrase indexing). Matching starts once both are done.
+    std::shared_future<std::vector<std::string>> ontologies = std::async(std::launch::async, load_ontology, ontologyPath, std::ref(index));
+    std::future<void> index_stage = std::async(std::launch::async, [&] { build_index(lsh, ontologies, ontologyPath, n, weighted); });
+    load_candidates(ingredientPath, possible_matches);
+    index_stage.get();
+    ontologies.get();
+
+    const size_t max_concurrent_tasks = std::min(std::thread::hardware_concurrency(), static_cast<unsigned int>(possible_matches.size()));
+    
+    std::vector<std::pair<std::string, std::string>> tasks = build_tasks();
 
     size_t chunk_size = (tasks.size() + max_concurrent_tasks - 1) / max_concurrent_tasks;
     std::vector<std::thread> workers;
@@ -183,7 +266,7 @@ void match(std::string ontologyPath, std::string ingredientPath, std::string out
         size_t end = std::min(start + chunk_size, tasks.size());
         std::vector<std::pair<std::string, std::string>> chunk_tasks(tasks.begin() + start, tasks.begin() + end);
 
-        workers.emplace_back(process_chunk, i, chunk_tasks,
+        workers.emplace_back(process_chunk<Index>, i, chunk_tasks,
                             std::ref(lsh), n);
     }
 
@@ -198,43 +281,363 @@ void match(std::string ontologyPath, std::string ingredientPath, std::string out
     int minutes = (total_seconds % 3600) / 60;
     int seconds = total_seconds % 60;
     
-    std::ofstream outFile(filename);
+    write_matches(filename, collect_matches(), index);
+}
+
+// Sharded variant of run_match: the index is split into numShards shard files served by local worker
+// processes, and the phrase queries are fanned out to them in batches. Returns false, without writing
+// output, if a shard cannot be built or a worker fails.
+bool run_match_sharded(int numShards, int hash_funcs, int band, std::string ontologyPath, std::string ingredientPath,
+                       std::string outputPath, size_t batch_size = 4096) {
+    std::unordered_map<std::string, std::pair<std::string, std::string>> index;
+    int n = 3;
+    ShardedLSH shards(numShards, band, hash_funcs, n);
+
+    std::unordered_map<std::string, std::unordered_set<std::string>> possible_matches;
+    std::shared_future<std::vector<std::string>> ontologies = std::async(std::launch::async, load_ontology, ontologyPath, std::ref(index));
+    std::future<void> index_stage = std::async(std::launch::async, [&] {
+        shards.build(ontologies.get(), ontologyPath);
+        shards.start(ontologyPath);
+    });
+    load_candidates(ingredientPath, possible_matches);
+
+    try {
+        index_stage.get();
+
+        std::vector<std::pair<std::string, std::string>> tasks = build_tasks();
+        for (size_t start = 0; start < tasks.size(); start += batch_size) {
+            size_t end = std::min(start + batch_size, tasks.size());
+            std::vector<std::string> phrases;
+            std::vector<double> thresholds;
+            for (size_t i = start; i < end; ++i) {
+                phrases.push_back(tasks[i].first);
+                thresholds.push_back(tasks[i].second == "single" ? 0.9 : 0.5);
+            }
+
+            auto results = shards.query_batch(phrases, thresholds);
+            for (size_t i = 0; i < phrases.size(); ++i) {
+                ingredients_matches[phrases[i]].insert(results[i].begin(), results[i].end());
+            }
+        }
+    }
+    catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return false;
+    }
+    if (!shards.stop()) {
+        std::cerr << "A shard worker exited abnormally" << std::endl;
+        return false;
+    }
+
+    write_matches(outputPath, collect_matches(), index);
+    return true;
+}
+
+// Runs the two engines over the same phrase queries, one query at a time, and reports their throughput
+// and how many of the exact prefix-join matches the LSH recovers.
+template <typename Index>
+void run_benchmark(Index& lsh, std::string ontologyPath, std::string ingredientPath, std::string outputPath, bool weighted = false) {
+    std::unordered_map<std::string, std::pair<std::string, std::string>> index;
+    int n = 3;
+
+    std::unordered_map<std::string, std::unordered_set<std::string>> possible_matches;
+    std::shared_future<std::vector<std::string>> ontologies = std::async(std::launch::deferred, load_ontology, ontologyPath, std::ref(index));
+    ontologies.get();
+    load_candidates(ingredientPath, possible_matches);
+    std::vector<std::pair<std::string, std::string>> tasks = build_tasks();
+
+    auto build_start = std::chrono::high_resolution_clock::now();
+    build_index(lsh, ontologies, ontologyPath, n, weighted);
+    auto build_mid = std::chrono::high_resolution_clock::now();
+    PrefixJoin join(0.5);
+    build_index(join, ontologies, ontologyPath, n);
+    auto build_stop = std::chrono::high_resolution_clock::now();
+
+    std::ostringstream report;
+    report << std::fixed << std::setprecision(3);
+    report << "queries\t" << tasks.size() << "\n";
+    report << "lsh_load_or_build_seconds\t" << std::chrono::duration<double>(build_mid - build_start).count() << "\n";
+    report << "prefix_build_seconds\t" << std::chrono::duration<double>(build_stop - build_mid).count() << "\n";
+
+    for (const std::string indicator : {"single", "multiple"}) {
+        double threshold = indicator == "single" ? 0.9 : 0.5;
+        std::vector<std::vector<std::string>> queries;
+        for (auto& task : tasks) {
+            if (task.second == indicator) {
+                queries.push_back(text_to_ngrams(task.first, n));
+            }
+        }
+
+        std::vector<std::unordered_set<std::string>> lsh_results(queries.size());
+        auto start = std::chrono::high_resolution_clock::now();
+        for (size_t i = 0; i < queries.size(); ++i) {
+            lsh_results[i] = lsh.query(queries[i], threshold);
+        }
+        double lsh_seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+        std::vector<std::unordered_set<std::string>> exact_results(queries.size());
+        start = std::chrono::high_resolution_clock::now();
+        for (size_t i = 0; i < queries.size(); ++i) {
+            exact_results[i] = join.query(queries[i], threshold);
+        }
+        double prefix_seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+        size_t lsh_total = 0, exact_total = 0, shared = 0;
+        for (size_t i = 0; i < queries.size(); ++i) {
+            lsh_total += lsh_results[i].size();
+            exact_total += exact_results[i].size();
+            for (auto& docID : lsh_results[i]) {
+                shared += exact_results[i].count(docID);
+            }
+        }
 
+        report << indicator << "_queries\t" << queries.size() << "\tthreshold\t" << threshold << "\n";
+        report << indicator << "_lsh_qps\t" << queries.size() / std::max(lsh_seconds, 1e-9)
+               << "\tprefix_qps\t" << queries.size() / std::max(prefix_seconds, 1e-9) << "\n";
+        report << indicator << "_lsh_matches\t" << lsh_total << "\tprefix_matches\t" << exact_total << "\n";
+        report << indicator << "_lsh_recall\t" << (exact_total ? static_cast<double>(shared) / exact_total : 1.0)
+               << "\tlsh_precision\t" << (lsh_total ? static_cast<double>(shared) / lsh_total : 1.0) << "\n";
+    }
+
+    std::cout << report.str();
+    std::ofstream outFile(outputPath);
     if (!outFile.is_open()) {
-        std::cerr << "Failed to open " << filename << std::endl;
+        std::cerr << "Failed to open " << outputPath << std::endl;
         return;
     }
+    outFile << report.str();
+}
 
-    std::unordered_map<std::string, std::unordered_set<std::string>> matches;
-    for (auto& [key, value] : ingredients_matches) {
-        if (inverted_index_multiple.find(key) != inverted_index_multiple.end()) {
-            auto lst = inverted_index_multiple[key];
-            for (auto& element : lst) {
-                matches[element].insert(value.begin(), value.end());
+// Runs every phrase query against one configuration, on all threads as in run_match, and scores the
+// resulting recipe matches against the LexMapr matches. Matched labels are mapped to their ontology IDs
+// through label_ids, since LexMapr reports term:ID pairs.
+template <typename Index>
+Evaluation evaluate(Index& index, Evaluation config, const std::vector<std::pair<std::string, std::string>>& tasks,
+                    const std::vector<std::vector<std::string>>& queries,
+                    const std::unordered_map<std::string, std::vector<std::string>>& label_ids,
+                    const std::unordered_map<std::string, std::unordered_set<std::string>>& possible_matches) {
+    std::vector<std::unordered_set<std::string>> results(queries.size());
+    std::vector<size_t> candidates(queries.size(), 0);
+    auto start = std::chrono::high_resolution_clock::now();
+    tbb::parallel_for(static_cast<size_t>(0), queries.size(), [&](size_t i) {
+        double threshold = tasks[i].second == "single" ? config.singleThreshold : config.multipleThreshold;
+        results[i] = index.query(queries[i], threshold, &candidates[i]);
+    });
+    double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+    std::unordered_map<std::string, std::unordered_set<std::string>> phrase_matches;
+    size_t total_candidates = 0, total_matches = 0;
+    for (size_t i = 0; i < queries.size(); ++i) {
+        total_candidates += candidates[i];
+        total_matches += results[i].size();
+        auto& ids = phrase_matches[tasks[i].first];
+        for (const auto& label : results[i]) {
+            auto it = label_ids.find(label);
+            if (it != label_ids.end()) {
+                ids.insert(it->second.begin(), it->second.end());
             }
         }
-        else if (inverted_index_single.find(key) != inverted_index_single.end()) {
-            auto lst = inverted_index_single[key];
-            for (auto& element : lst) {
-                matches[element].insert(value.begin(), value.end());
+    }
+    config.candidatesPerQuery = queries.empty() ? 0.0 : static_cast<double>(total_candidates) / queries.size();
+    config.matchesPerQuery = queries.empty() ? 0.0 : static_cast<double>(total_matches) / queries.size();
+    config.qps = queries.size() / std::max(seconds, 1e-9);
+    score_matches(config, collect_matches(phrase_matches), possible_matches);
+    return config;
+}
+
+// Sweeps engines, LSH band counts, weighting and the (single word, multiple word) thresholds over the
+// same phrase queries, and writes each configuration's scores against the LexMapr matches in the
+// candidate CSV, with the Pareto frontier over precision, recall and throughput marked.
+void run_evaluation(std::string ontologyPath, std::string ingredientPath, std::string outputPath, int hash_funcs = 100) {
+    std::unordered_map<std::string, std::pair<std::string, std::string>> index;
+    int n = 3;
+
+    std::unordered_map<std::string, std::unordered_set<std::string>> possible_matches;
+    std::shared_future<std::vector<std::string>> ontologies = std::async(std::launch::async, load_ontology, ontologyPath, std::ref(index));
+    load_candidates(ingredientPath, possible_matches);
+    const auto& labels = ontologies.get();
+
+    // Index documents are labels, while LexMapr reports ontology IDs. Several IDs can share a label.
+    std::unordered_map<std::string, std::vector<std::string>> label_ids;
+    for (const auto& [id, label] : inverted_index) {
+        label_ids[label].push_back(id);
+    }
+
+    // LexMapr also reports IDs that are never indexed (parseJson skips ENVO_ terms, for one). No
+    // configuration can find them, so they are left out of recall and reported instead.
+    size_t expected_ids = 0, unindexed_ids = 0;
+    std::string unindexed_example;
+    for (auto it = possible_matches.begin(); it != possible_matches.end();) {
+        auto& ids = it->second;
+        expected_ids += ids.size();
+        for (auto id = ids.begin(); id != ids.end();) {
+            if (inverted_index.find(*id) == inverted_index.end()) {
+                unindexed_example = *id;
+                ++unindexed_ids;
+                id = ids.erase(id);
+            }
+            else {
+                ++id;
             }
         }
+        it = ids.empty() ? possible_matches.erase(it) : std::next(it);
+    }
+    if (unindexed_ids > 0) {
+        std::cout << "Ignoring " << unindexed_ids << " of " << expected_ids << " LexMapr IDs that are not indexed in "
+                  << ontologyPath << " (e.g. " << unindexed_example << ")" << std::endl;
     }
 
-    for (auto& [key, value] : matches) {
-        outFile << key << std::endl;
-        for (auto& v : value) {
-            outFile << "(" << index[v].first << " " << index[v].second << "), ";
+    std::vector<std::pair<std::string, std::string>> tasks = build_tasks();
+    std::vector<std::vector<std::string>> queries;
+    for (auto& task : tasks) {
+        queries.push_back(text_to_ngrams(task.first, n));
+    }
+
+    const std::vector<std::pair<double, double>> thresholds = {
+        {0.9, 0.3}, {0.9, 0.4}, {0.9, 0.5}, {0.9, 0.6}, {0.9, 0.7},
+        {0.8, 0.3}, {0.8, 0.4}, {0.8, 0.5}, {0.8, 0.6}, {0.8, 0.7}};
+    std::vector<Evaluation> evaluations;
+    auto sweep = [&](auto& engine, Evaluation config) {
+        for (auto [single, multiple] : thresholds) {
+            config.singleThreshold = single;
+            config.multipleThreshold = multiple;
+            evaluations.push_back(evaluate(engine, config, tasks, queries, label_ids, possible_matches));
+        }
+    };
+
+    PrefixJoin join(0.3);
+    build_index(join, ontologies, ontologyPath, n);
+    sweep(join, Evaluation{"prefix"});
+
+    // Label signatures depend on the number of hashes and the weighting but not on the banding, so they
+    // are computed once per weighting and then banded for every band count.
+    std::vector<std::vector<std::string>> documents;
+    for (const auto& label : labels) {
+        documents.push_back(text_to_ngrams(label, n));
+    }
+    std::vector<std::vector<unsigned long>> label_signatures[2];
+    for (bool weighted : {false, true}) {
+        LSH signer(1, hash_funcs);
+        if (weighted) {
+            signer.fit_idf(documents);
+        }
+        auto& signatures = label_signatures[weighted];
+        signatures.resize(documents.size());
+        tbb::parallel_for(static_cast<size_t>(0), documents.size(), [&](size_t i) {
+            signatures[i] = signer.compute_signature(documents[i]);
+        });
+    }
+
+    for (int band : {10, 20, 25, 50}) {
+        for (bool weighted : {false, true}) {
+            with_lsh(hash_funcs, band, [&](auto& lsh) {
+                if (weighted) {
+                    lsh.fit_idf(documents);
+                }
+                for (size_t i = 0; i < labels.size(); ++i) {
+                    lsh.insert_signature(label_signatures[weighted][i], labels[i]);
+                }
+                lsh.freeze();
+                sweep(lsh, Evaluation{"lsh", band, weighted ? "idf" : "none"});
+            });
         }
-        outFile << "\n";
     }
+    mark_pareto_frontier(evaluations);
 
+    if (std::all_of(evaluations.begin(), evaluations.end(), [](const Evaluation& e) { return e.recall == 0; })) {
+        std::cerr << "No configuration matched any LexMapr ontology ID; check that the candidate CSV lists term:ID pairs "
+                  << "whose IDs are keys of " << ontologyPath << std::endl;
+    }
+
+    std::vector<Evaluation> frontier;
+    std::copy_if(evaluations.begin(), evaluations.end(), std::back_inserter(frontier), [](const Evaluation& e) { return e.pareto; });
+    std::sort(frontier.begin(), frontier.end(), [](const Evaluation& a, const Evaluation& b) { return a.qps > b.qps; });
+    std::cout << "Pareto frontier (" << frontier.size() << " of " << evaluations.size() << " configurations):\n";
+    write_evaluations(std::cout, frontier);
+
+    std::ofstream outFile(outputPath);
+    if (!outFile.is_open()) {
+        std::cerr << "Failed to open " << outputPath << std::endl;
+        return;
+    }
+    write_evaluations(outFile, evaluations);
+}
+
+// engine is "lsh" (approximate, MinHash LSH) or "prefix" (exact prefix-filtering join).
+// weighted selects TF-IDF weighted MinHash for the LSH engine.
+void match(std::string ontologyPath, std::string ingredientPath, std::string outputPath, int hash_funcs = 100, int band = 25,
+           std::string engine = "lsh", bool weighted = false) {
+    if (engine == "prefix") {
+        PrefixJoin join(0.5);
+        run_match(join, ontologyPath, ingredientPath, outputPath);
+    }
+    else {
+        with_lsh(hash_funcs, band, [&](auto& lsh) { run_match(lsh, ontologyPath, ingredientPath, outputPath, weighted); });
+    }
+}
+
+void benchmark(std::string ontologyPath, std::string ingredientPath, std::string outputPath, int hash_funcs = 100, int band = 25,
+               bool weighted = false) {
+    with_lsh(hash_funcs, band, [&](auto& lsh) { run_benchmark(lsh, ontologyPath, ingredientPath, outputPath, weighted); });
 }
 
 int main(int argc, char** argv) {
-    if (argc != 4) {
-        std::cout << "Usage: ./EntityMatching [path_to_ontology] [path_to_candiates] [path_to_output]\n";
+    // Internal mode used by --shards: ./EntityMatching --shard-worker [shard_file] [shard] [num_shards] [hash_funcs] [band]
+    if (argc == 7 && std::string(argv[1]) == "--shard-worker") {
+        return run_shard_worker(argv[2], std::stoi(argv[3]), std::stoi(argv[4]), std::stoi(argv[5]), std::stoi(argv[6]));
+    }
+
+    std::vector<std::string> args;
+    std::string engine = "lsh";
+    bool run_bench = false;
+    bool run_eval = false;
+    int num_shards = 0;
+    std::string weighting = "none";
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg.rfind("--engine=", 0) == 0) {
+            engine = arg.substr(9);
+        }
+        else if (arg.rfind("--weighting=", 0) == 0) {
+            weighting = arg.substr(12);
+        }
+        else if (arg.rfind("--shards=", 0) == 0) {
+            std::string value = arg.substr(9);
+            bool numeric = !value.empty() && value.size() <= 4 && std::all_of(value.begin(), value.end(), ::isdigit);
+            num_shards = numeric ? std::stoi(value) : -1;
+        }
+        else if (arg == "--benchmark") {
+            run_bench = true;
+        }
+        else if (arg == "--evaluate") {
+            run_eval = true;
+        }
+        else {
+            args.push_back(arg);
+        }
+    }
+
+    if ((args.size() != 3 && args.size() != 4) || (engine != "lsh" && engine != "prefix") || num_shards < 0
+        || (weighting != "none" && weighting != "idf") || (weighting == "idf" && (engine != "lsh" || num_shards > 0))
+        || (num_shards > 0 && (engine != "lsh" || run_bench)) || (run_eval && (run_bench || num_shards > 0))) {
+        std::cout << "Usage: ./EntityMatching [--engine=lsh|prefix] [--weighting=none|idf] [--shards=N] [--benchmark] [--evaluate] [path_to_ontology] [path_to_candiates] [path_to_output] [path_to_stop_words (optional)]\n";
         return -1;
     }
-    match(argv[1], argv[2], argv[3]);
+    if (args.size() == 4 && !domain_stop_words.load(args[3])) {
+        return -1;
+    }
+    if (run_eval) {
+        run_evaluation(args[0], args[1], args[2], 100);
+    }
+    else if (run_bench) {
+        benchmark(args[0], args[1], args[2], 100, 25, weighting == "idf");
+    }
+    else if (num_shards > 0) {
+        if (!run_match_sharded(num_shards, 100, 25, args[0], args[1], args[2])) {
+            return -1;
+        }
+    }
+    else {
+        match(args[0], args[1], args[2], 100, 25, engine, weighting == "idf");
+    }
 }
\ No newline at end of file
@@ -0,0 +1,587 @@
+// Python module exposing the native LSH engine and tokenizers to the notebooks. Build with `make python`.
+//
+// Written against the CPython and NumPy C APIs, so it needs nothing beyond the Python headers and NumPy.
+// Signatures and match results cross the boundary as NumPy arrays: C-contiguous uint64 signature arrays
+// are read in place, and result arrays take ownership of the native buffers. Every method releases the
+// GIL while it works on the index; batch operations also run across threads.
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#define NPY_NO_DEPRECATED_API NPY_1_7_API_VERSION
+#include <numpy/arrayobject.h>
+#include "LSH.h"
+#include "NGram.h"
+#include "StopWords.h"
+#include <tbb/parallel_for.h>
+#include <mutex>
+#include <shared_mutex>
+
+static_assert(sizeof(unsigned long) == sizeof(npy_uint64), "signatures are exchanged as uint64 arrays");
+
+// Thrown when a Python exception is already set, e.g. by a failed argument conversion.
+struct PythonError {};
+
+// Releases the GIL for its lifetime, including while an exception unwinds.
+class ReleaseGIL {
+public:
+    ReleaseGIL() : state(PyEval_SaveThread()) {}
+    ~ReleaseGIL() {
+        PyEval_RestoreThread(state);
+    }
+
+private:
+    PyThreadState* state;
+};
+
+// Owns one reference for the lifetime of the holder.
+struct Reference {
+    PyObject* object;
+    ~Reference() {
+        Py_XDECREF(object);
+    }
+};
+
+// Runs a method body, turning C++ exceptions into Python exceptions.
+template <typename Body>
+PyObject* guarded(Body&& body) {
+    try {
+        return body();
+    }
+    catch (const PythonError&) {
+    }
+    catch (const std::invalid_argument& e) {
+        PyErr_SetString(PyExc_ValueError, e.what());
+    }
+    catch (const std::exception& e) {
+        PyErr_SetString(PyExc_RuntimeError, e.what());
+    }
+    return nullptr;
+}
+
+std::vector<std::string> to_strings(PyObject* sequence) {
+    Reference fast{PySequence_Fast(sequence, "expected a sequence of str")};
+    if (!fast.object) {
+        throw PythonError();
+    }
+    Py_ssize_t size = PySequence_Fast_GET_SIZE(fast.object);
+    std::vector<std::string> result;
+    result.reserve(size);
+    for (Py_ssize_t i = 0; i < size; ++i) {
+        Py_ssize_t length;
+        const char* data = PyUnicode_AsUTF8AndSize(PySequence_Fast_GET_ITEM(fast.object, i), &length);
+        if (!data) {
+            throw PythonError();
+        }
+        result.emplace_back(data, length);
+    }
+    return result;
+}
+
+PyObject* to_list(const std::vector<std::string>& values) {
+    PyObject* list = PyList_New(values.size());
+    if (!list) {
+        throw PythonError();
+    }
+    for (size_t i = 0; i < values.size(); ++i) {
+        PyObject* str = PyUnicode_DecodeUTF8(values[i].data(), values[i].size(), "replace");
+        if (!str) {
+            Py_DECREF(list);
+            throw PythonError();
+        }
+        PyList_SET_ITEM(list, i, str);
+    }
+    return list;
+}
+
+PyObject* to_set(const std::unordered_set<std::string>& values) {
+    PyObject* set = PySet_New(nullptr);
+    if (!set) {
+        throw PythonError();
+    }
+    for (const auto& value : values) {
+        PyObject* str = PyUnicode_DecodeUTF8(value.data(), value.size(), "replace");
+        if (!str || PySet_Add(set, str) < 0) {
+            Py_XDECREF(str);
+            Py_DECREF(set);
+            throw PythonError();
+        }
+        Py_DECREF(str);
+    }
+    return set;
+}
+
+template <typename T>
+constexpr int numpy_type();
+template <>
+constexpr int numpy_type<unsigned long>() { return NPY_UINT64; }
+template <>
+constexpr int numpy_type<uint32_t>() { return NPY_UINT32; }
+
+// Hands a vector to NumPy without copying; the capsule frees it together with the array.
+template <typename T>
+PyObject* to_numpy(std::vector<T>&& values, std::vector<npy_intp> shape) {
+    auto* owned = new std::vector<T>(std::move(values));
+    if (owned->empty()) {
+        owned->reserve(1);
+    }
+    PyObject* owner = PyCapsule_New(owned, nullptr, [](PyObject* capsule) {
+        delete static_cast<std::vector<T>*>(PyCapsule_GetPointer(capsule, nullptr));
+    });
+    if (!owner) {
+        delete owned;
+        throw PythonError();
+    }
+    PyObject* array = PyArray_SimpleNewFromData(static_cast<int>(shape.size()), shape.data(), numpy_type<T>(), owned->data());
+    if (!array) {
+        Py_DECREF(owner);
+        throw PythonError();
+    }
+    // Steals the reference to owner, even on failure.
+    if (PyArray_SetBaseObject(reinterpret_cast<PyArrayObject*>(array), owner) < 0) {
+        Py_DECREF(array);
+        throw PythonError();
+    }
+    return array;
+}
+
+// Matches as CSR arrays: the ordinals of query i are ordinals[offsets[i]:offsets[i + 1]].
+PyObject* to_csr(std::vector<std::vector<uint32_t>>&& results) {
+    std::vector<unsigned long> offsets(results.size() + 1, 0);
+    for (size_t i = 0; i < results.size(); ++i) {
+        offsets[i + 1] = offsets[i] + results[i].size();
+    }
+    std::vector<uint32_t> ordinals;
+    ordinals.reserve(offsets.back());
+    for (auto& result : results) {
+        ordinals.insert(ordinals.end(), result.begin(), result.end());
+    }
+    npy_intp queries = static_cast<npy_intp>(results.size());
+    npy_intp total = static_cast<npy_intp>(ordinals.size());
+    Reference offsetArray{to_numpy(std::move(offsets), {queries + 1})};
+    Reference ordinalArray{to_numpy(std::move(ordinals), {total})};
+    return PyTuple_Pack(2, offsetArray.object, ordinalArray.object);
+}
+
+// A threshold is either one number for every query or a sequence with one entry per query.
+std::vector<double> to_thresholds(PyObject* object, size_t queries) {
+    if (PyFloat_Check(object) || PyLong_Check(object)) {
+        double threshold = PyFloat_AsDouble(object);
+        if (threshold == -1.0 && PyErr_Occurred()) {
+            throw PythonError();
+        }
+        return std::vector<double>(queries, threshold);
+    }
+    Reference array{PyArray_FROMANY(object, NPY_DOUBLE, 1, 1, NPY_ARRAY_IN_ARRAY)};
+    if (!array.object) {
+        throw PythonError();
+    }
+    auto* thresholds = reinterpret_cast<PyArrayObject*>(array.object);
+    if (static_cast<size_t>(PyArray_DIM(thresholds, 0)) != queries) {
+        throw std::invalid_argument("thresholds must have one entry per query");
+    }
+    const double* data = static_cast<const double*>(PyArray_DATA(thresholds));
+    return std::vector<double>(data, data + queries);
+}
+
+// Readers-writer lock that lets a waiting writer in ahead of readers arriving after it. std::shared_mutex
+// makes no such promise (glibc prefers readers), so a steady stream of queries could starve an insert.
+class IndexLock {
+public:
+    void lock() {
+        std::lock_guard<std::mutex> entry(gate);
+        mutex.lock();
+    }
+    void unlock() {
+        mutex.unlock();
+    }
+    void lock_shared() {
+        { std::lock_guard<std::mutex> entry(gate); }
+        mutex.lock_shared();
+    }
+    void unlock_shared() {
+        mutex.unlock_shared();
+    }
+
+private:
+    std::mutex gate;
+    std::shared_mutex mutex;
+};
+
+struct PyLSH {
+    PyObject_HEAD
+    LSH* lsh;
+    // Exclusive for the methods that modify the index, shared for the ones that only read it.
+    IndexLock* lock;
+};
+
+using ExclusiveLock = std::unique_lock<IndexLock>;
+using SharedLock = std::shared_lock<IndexLock>;
+
+// Runs body on the index with the GIL released and the index lock held. The lock is taken only after
+// the GIL is released, so a thread waiting for it never blocks the interpreter.
+template <typename Lock, typename Body>
+auto with_index(PyObject* self, Body&& body) {
+    auto* object = reinterpret_cast<PyLSH*>(self);
+    if (!object->lsh) {
+        throw std::runtime_error("LSH is not initialized");
+    }
+    ReleaseGIL release;
+    Lock lock(*object->lock);
+    return body(*object->lsh);
+}
+
+int lsh_init(PyObject* self, PyObject* args, PyObject* kwargs) {
+    static const char* keywords[] = {"num_bands", "num_hashes", nullptr};
+    int numBands, numHashes = 100;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "i|i", const_cast<char**>(keywords), &numBands, &numHashes)) {
+        return -1;
+    }
+    if (numBands <= 0 || numHashes < numBands) {
+        PyErr_SetString(PyExc_ValueError, "num_bands must be positive and at most num_hashes");
+        return -1;
+    }
+    // Another thread may be inside a method of this object, so the index is never replaced.
+    auto* object = reinterpret_cast<PyLSH*>(self);
+    if (object->lsh) {
+        PyErr_SetString(PyExc_RuntimeError, "LSH is already initialized");
+        return -1;
+    }
+    object->lock = new IndexLock();
+    object->lsh = new LSH(numBands, numHashes);
+    return 0;
+}
+
+void lsh_dealloc(PyObject* self) {
+    auto* object = reinterpret_cast<PyLSH*>(self);
+    delete object->lsh;
+    delete object->lock;
+    Py_TYPE(self)->tp_free(self);
+}
+
+PyObject* lsh_insert(PyObject* self, PyObject* args, PyObject* kwargs) {
+    return guarded([&]() -> PyObject* {
+        static const char* keywords[] = {"text", "doc_id", "n", nullptr};
+        const char* text;
+        const char* docID;
+        Py_ssize_t textSize, docIDSize;
+        int n = 3;
+        if (!PyArg_ParseTupleAndKeywords(args, kwargs, "s#s#|i", const_cast<char**>(keywords), &text, &textSize, &docID, &docIDSize, &n)) {
+            return nullptr;
+        }
+        std::string textString(text, textSize), docIDString(docID, docIDSize);
+        with_index<ExclusiveLock>(self, [&](LSH& lsh) { lsh.insert(text_to_ngrams(textString, n), docIDString); });
+        Py_RETURN_NONE;
+    });
+}
+
+PyObject* lsh_insert_batch(PyObject* self, PyObject* args, PyObject* kwargs) {
+    return guarded([&]() -> PyObject* {
+        static const char* keywords[] = {"texts", "doc_ids", "n", nullptr};
+        PyObject* textsObject;
+        PyObject* docIDsObject;
+        int n = 3;
+        if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OO|i", const_cast<char**>(keywords), &textsObject, &docIDsObject, &n)) {
+            return nullptr;
+        }
+        auto texts = to_strings(textsObject);
+        auto docIDs = to_strings(docIDsObject);
+        if (texts.size() != docIDs.size()) {
+            throw std::invalid_argument("texts and doc_ids must have the same length");
+        }
+        with_index<ExclusiveLock>(self, [&](LSH& lsh) {
+            for (size_t i = 0; i < texts.size(); ++i) {
+                lsh.insert(text_to_ngrams(texts[i], n), docIDs[i]);
+            }
+        });
+        Py_RETURN_NONE;
+    });
+}
+
+PyObject* lsh_fit_idf(PyObject* self, PyObject* args, PyObject* kwargs) {
+    return guarded([&]() -> PyObject* {
+        static const char* keywords[] = {"texts", "n", nullptr};
+        PyObject* textsObject;
+        int n = 3;
+        if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|i", const_cast<char**>(keywords), &textsObject, &n)) {
+            return nullptr;
+        }
+        auto texts = to_strings(textsObject);
+        with_index<ExclusiveLock>(self, [&](LSH& lsh) {
+            std::vector<std::vector<std::string>> documents;
+            for (const auto& text : texts) {
+                documents.push_back(text_to_ngrams(text, n));
+            }
+            lsh.fit_idf(documents);
+        });
+        Py_RETURN_NONE;
+    });
+}
+
+PyObject* lsh_freeze(PyObject* self, PyObject*) {
+    return guarded([&]() -> PyObject* {
+        with_index<ExclusiveLock>(self, [](LSH& lsh) { lsh.freeze(); });
+        Py_RETURN_NONE;
+    });
+}
+
+PyObject* lsh_save(PyObject* self, PyObject* args) {
+    return guarded([&]() -> PyObject* {
+        const char* filename;
+        if (!PyArg_ParseTuple(args, "s", &filename)) {
+            return nullptr;
+        }
+        std::string path(filename);
+        return PyBool_FromLong(with_index<SharedLock>(self, [&](LSH& lsh) { return lsh.save_to_disk(path); }));
+    });
+}
+
+PyObject* lsh_load(PyObject* self, PyObject* args) {
+    return guarded([&]() -> PyObject* {
+        const char* filename;
+        if (!PyArg_ParseTuple(args, "s", &filename)) {
+            return nullptr;
+        }
+        std::string path(filename);
+        return PyBool_FromLong(with_index<ExclusiveLock>(self, [&](LSH& lsh) { return lsh.load_from_disk(path); }));
+    });
+}
+
+PyObject* lsh_doc_ids(PyObject* self, PyObject*) {
+    return guarded([&]() -> PyObject* {
+        return to_list(with_index<SharedLock>(self, [](LSH& lsh) { return lsh.doc_ids(); }));
+    });
+}
+
+PyObject* lsh_query(PyObject* self, PyObject* args, PyObject* kwargs) {
+    return guarded([&]() -> PyObject* {
+        static const char* keywords[] = {"text", "threshold", "n", nullptr};
+        const char* text;
+        Py_ssize_t textSize;
+        double threshold = 0.4;
+        int n = 3;
+        if (!PyArg_ParseTupleAndKeywords(args, kwargs, "s#|di", const_cast<char**>(keywords), &text, &textSize, &threshold, &n)) {
+            return nullptr;
+        }
+        std::string textString(text, textSize);
+        return to_set(with_index<SharedLock>(self, [&](LSH& lsh) { return lsh.query(text_to_ngrams(textString, n), threshold); }));
+    });
+}
+
+PyObject* lsh_signatures(PyObject* self, PyObject* args, PyObject* kwargs) {
+    return guarded([&]() -> PyObject* {
+        static const char* keywords[] = {"phrases", "n", nullptr};
+        PyObject* phrasesObject;
+        int n = 3;
+        if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|i", const_cast<char**>(keywords), &phrasesObject, &n)) {
+            return nullptr;
+        }
+        auto phrases = to_strings(phrasesObject);
+        size_t numHashes = 0;
+        auto flat = with_index<SharedLock>(self, [&](LSH& lsh) {
+            numHashes = lsh.num_hashes();
+            std::vector<unsigned long> flat(phrases.size() * numHashes);
+            tbb::parallel_for(static_cast<size_t>(0), phrases.size(), [&](size_t i) {
+                auto signature = lsh.compute_signature(text_to_ngrams(phrases[i], n));
+                std::copy(signature.begin(), signature.end(), flat.begin() + i * numHashes);
+            });
+            return flat;
+        });
+        return to_numpy(std::move(flat), {static_cast<npy_intp>(phrases.size()), static_cast<npy_intp>(numHashes)});
+    });
+}
+
+PyObject* lsh_query_signatures(PyObject* self, PyObject* args, PyObject* kwargs) {
+    return guarded([&]() -> PyObject* {
+        static const char* keywords[] = {"signatures", "thresholds", nullptr};
+        PyObject* signaturesObject;
+        PyObject* thresholdsObject;
+        if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OO", const_cast<char**>(keywords), &signaturesObject, &thresholdsObject)) {
+            return nullptr;
+        }
+
+        // Returns the input itself when it is already a C-contiguous uint64 array.
+        Reference array{PyArray_FROMANY(signaturesObject, NPY_UINT64, 2, 2, NPY_ARRAY_IN_ARRAY)};
+        if (!array.object) {
+            throw PythonError();
+        }
+        auto* signatures = reinterpret_cast<PyArrayObject*>(array.object);
+        size_t queries = PyArray_DIM(signatures, 0);
+        size_t columns = PyArray_DIM(signatures, 1);
+        auto thresholds = to_thresholds(thresholdsObject, queries);
+
+        const unsigned long* data = static_cast<const unsigned long*>(PyArray_DATA(signatures));
+        auto results = with_index<SharedLock>(self, [&](LSH& lsh) {
+            if (columns != lsh.num_hashes()) {
+                throw std::invalid_argument("signatures must have shape (queries, num_hashes)");
+            }
+            std::vector<std::vector<uint32_t>> results(queries);
+            tbb::parallel_for(static_cast<size_t>(0), queries, [&](size_t i) {
+                results[i] = lsh.query_ordinals(data + i * columns, thresholds[i]);
+            });
+            return results;
+        });
+        return to_csr(std::move(results));
+    });
+}
+
+PyObject* lsh_query_batch(PyObject* self, PyObject* args, PyObject* kwargs) {
+    return guarded([&]() -> PyObject* {
+        static const char* keywords[] = {"phrases", "thresholds", "n", nullptr};
+        PyObject* phrasesObject;
+        PyObject* thresholdsObject;
+        int n = 3;
+        if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OO|i", const_cast<char**>(keywords), &phrasesObject, &thresholdsObject, &n)) {
+            return nullptr;
+        }
+        auto phrases = to_strings(phrasesObject);
+        auto thresholds = to_thresholds(thresholdsObject, phrases.size());
+        auto results = with_index<SharedLock>(self, [&](LSH& lsh) {
+            std::vector<std::vector<uint32_t>> results(phrases.size());
+            tbb::parallel_for(static_cast<size_t>(0), phrases.size(), [&](size_t i) {
+                results[i] = lsh.query_ordinals(lsh.compute_signature(text_to_ngrams(phrases[i], n)).data(), thresholds[i]);
+            });
+            return results;
+        });
+        return to_csr(std::move(results));
+    });
+}
+
+PyObject* lsh_frozen(PyObject* self, void*) {
+    return guarded([&]() -> PyObject* {
+        return PyBool_FromLong(with_index<SharedLock>(self, [](LSH& lsh) { return lsh.is_frozen(); }));
+    });
+}
+
+PyObject* lsh_weighted(PyObject* self, void*) {
+    return guarded([&]() -> PyObject* {
+        return PyBool_FromLong(with_index<SharedLock>(self, [](LSH& lsh) { return lsh.is_weighted(); }));
+    });
+}
+
+PyObject* lsh_num_hashes(PyObject* self, void*) {
+    return guarded([&]() -> PyObject* {
+        return PyLong_FromSize_t(with_index<SharedLock>(self, [](LSH& lsh) { return lsh.num_hashes(); }));
+    });
+}
+
+PyMethodDef lsh_methods[] = {
+    {"insert", reinterpret_cast<PyCFunction>(reinterpret_cast<void (*)(void)>(lsh_insert)), METH_VARARGS | METH_KEYWORDS,
+     "insert(text, doc_id, n=3)"},
+    {"insert_batch", reinterpret_cast<PyCFunction>(reinterpret_cast<void (*)(void)>(lsh_insert_batch)), METH_VARARGS | METH_KEYWORDS,
+     "insert_batch(texts, doc_ids, n=3)"},
+    {"fit_idf", reinterpret_cast<PyCFunction>(reinterpret_cast<void (*)(void)>(lsh_fit_idf)), METH_VARARGS | METH_KEYWORDS,
+     "fit_idf(texts, n=3)\n\nSwitch to TF-IDF weighted MinHash. Call before inserting."},
+    {"freeze", lsh_freeze, METH_NOARGS, "freeze()"},
+    {"save", lsh_save, METH_VARARGS, "save(filename) -> bool"},
+    {"load", lsh_load, METH_VARARGS, "load(filename) -> bool"},
+    {"doc_ids", lsh_doc_ids, METH_NOARGS,
+     "doc_ids() -> list[str]\n\nDocument IDs of the frozen index, indexed by the ordinals queries return."},
+    {"query", reinterpret_cast<PyCFunction>(reinterpret_cast<void (*)(void)>(lsh_query)), METH_VARARGS | METH_KEYWORDS,
+     "query(text, threshold=0.4, n=3) -> set[str]"},
+    {"signatures", reinterpret_cast<PyCFunction>(reinterpret_cast<void (*)(void)>(lsh_signatures)), METH_VARARGS | METH_KEYWORDS,
+     "signatures(phrases, n=3) -> uint64 array of shape (len(phrases), num_hashes)"},
+    {"query_signatures", reinterpret_cast<PyCFunction>(reinterpret_cast<void (*)(void)>(lsh_query_signatures)),
+     METH_VARARGS | METH_KEYWORDS,
+     "query_signatures(signatures, thresholds) -> (offsets, ordinals)\n\n"
+     "Match precomputed signatures of a frozen index. thresholds is a number or one entry per row."},
+    {"query_batch", reinterpret_cast<PyCFunction>(reinterpret_cast<void (*)(void)>(lsh_query_batch)), METH_VARARGS | METH_KEYWORDS,
+     "query_batch(phrases, thresholds, n=3) -> (offsets, ordinals)\n\n"
+     "Match phrases against a frozen index on all cores. thresholds is a number or one entry per phrase."},
+    {nullptr, nullptr, 0, nullptr}};
+
+PyGetSetDef lsh_properties[] = {
+    {"frozen", lsh_frozen, nullptr, nullptr, nullptr},
+    {"weighted", lsh_weighted, nullptr, nullptr, nullptr},
+    {"num_hashes", lsh_num_hashes, nullptr, nullptr, nullptr},
+    {nullptr, nullptr, nullptr, nullptr, nullptr}};
+
+PyTypeObject LSHType = {PyVarObject_HEAD_INIT(nullptr, 0)};
+
+PyObject* module_text_to_ngrams(PyObject*, PyObject* args, PyObject* kwargs) {
+    return guarded([&]() -> PyObject* {
+        static const char* keywords[] = {"text", "n", nullptr};
+        const char* text;
+        Py_ssize_t textSize;
+        int n = 3;
+        if (!PyArg_ParseTupleAndKeywords(args, kwargs, "s#|i", const_cast<char**>(keywords), &text, &textSize, &n)) {
+            return nullptr;
+        }
+        return to_list(text_to_ngrams(std::string(text, textSize), n));
+    });
+}
+
+PyObject* module_text_to_ngrams_words(PyObject*, PyObject* args, PyObject* kwargs) {
+    return guarded([&]() -> PyObject* {
+        static const char* keywords[] = {"words", "n", nullptr};
+        PyObject* wordsObject;
+        int n = 3;
+        if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|i", const_cast<char**>(keywords), &wordsObject, &n)) {
+            return nullptr;
+        }
+        return to_list(text_to_ngrams_words(to_strings(wordsObject), n));
+    });
+}
+
+PyObject* module_filter_string(PyObject*, PyObject* args) {
+    return guarded([&]() -> PyObject* {
+        const char* text;
+        Py_ssize_t textSize;
+        if (!PyArg_ParseTuple(args, "s#", &text, &textSize)) {
+            return nullptr;
+        }
+        return to_list(filter_string(std::string(text, textSize)));
+    });
+}
+
+PyObject* module_load_stop_words(PyObject*, PyObject* args) {
+    return guarded([&]() -> PyObject* {
+        const char* filename;
+        if (!PyArg_ParseTuple(args, "s", &filename)) {
+            return nullptr;
+        }
+        return PyBool_FromLong(domain_stop_words.load(filename));
+    });
+}
+
+PyMethodDef module_methods[] = {
+    {"text_to_ngrams", reinterpret_cast<PyCFunction>(reinterpret_cast<void (*)(void)>(module_text_to_ngrams)),
+     METH_VARARGS | METH_KEYWORDS, "text_to_ngrams(text, n=3) -> list[str]"},
+    {"text_to_ngrams_words", reinterpret_cast<PyCFunction>(reinterpret_cast<void (*)(void)>(module_text_to_ngrams_words)),
+     METH_VARARGS | METH_KEYWORDS, "text_to_ngrams_words(words, n=3) -> list[str]"},
+    {"filter_string", module_filter_string, METH_VARARGS,
+     "filter_string(text) -> list[str]\n\nLowercase the words of a phrase, strip non-letters and drop stop words."},
+    {"load_stop_words", module_load_stop_words, METH_VARARGS,
+     "load_stop_words(filename) -> bool\n\nAdd domain stop words from a whitespace-separated word file."},
+    {nullptr, nullptr, 0, nullptr}};
+
+PyModuleDef entity_matching_module = {PyModuleDef_HEAD_INIT, "entity_matching", "MinHash LSH ontology matching engine", -1,
+                                      module_methods};
+
+PyMODINIT_FUNC PyInit_entity_matching() {
+    import_array();
+
+    LSHType.tp_name = "entity_matching.LSH";
+    LSHType.tp_doc = "LSH(num_bands, num_hashes=100)";
+    LSHType.tp_basicsize = sizeof(PyLSH);
+    LSHType.tp_flags = Py_TPFLAGS_DEFAULT;
+    LSHType.tp_new = PyType_GenericNew;
+    LSHType.tp_init = lsh_init;
+    LSHType.tp_dealloc = lsh_dealloc;
+    LSHType.tp_methods = lsh_methods;
+    LSHType.tp_getset = lsh_properties;
+    if (PyType_Ready(&LSHType) < 0) {
+        return nullptr;
+    }
+
+    PyObject* module = PyModule_Create(&entity_matching_module);
+    if (!module) {
+        return nullptr;
+    }
+    Py_INCREF(&LSHType);
+    if (PyModule_AddObject(module, "LSH", reinterpret_cast<PyObject*>(&LSHType)) < 0) {
+        Py_DECREF(&LSHType);
+        Py_DECREF(module);
+        return nullptr;
+    }
+    return module;
+}
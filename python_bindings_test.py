@@ -0,0 +1,163 @@
+# Smoke test of the entity_matching Python module, run by `make python` after building it.
+# Uses synthetic labels, so it needs no ontology files.
+
+import gc
+import itertools
+import os
+import resource
+import sys
+import tempfile
+import threading
+from concurrent.futures import ThreadPoolExecutor
+
+import numpy as np
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+import entity_matching as em
+
+adjectives = ["red", "green", "dried", "smoked", "ground", "fresh", "black", "sweet", "wild", "roasted"]
+foods = ["pepper", "onion", "tomato", "bean", "chili", "garlic", "olive", "salmon", "ginger", "lentil",
+         "cabbage", "mustard", "walnut", "barley", "paprika"]
+forms = ["", " seed", " oil", " powder", " leaf"]
+labels = [f"{a} {f}{s}" for a, f, s in itertools.product(adjectives, foods, forms)]
+phrases = labels[::7] + ["red pepper flakes", "olive oil", "chicken pepper", "zzz", ""]
+thresholds = np.where(np.arange(len(phrases)) % 2 == 0, 0.5, 0.9)
+
+
+def expect_error(call, exception):
+    try:
+        call()
+    except exception:
+        return
+    raise AssertionError(f"expected {exception.__name__}")
+
+
+frozen = em.LSH(25, 100)
+frozen.insert_batch(labels, labels)
+assert not frozen.frozen
+frozen.freeze()
+frozen.freeze()
+assert frozen.frozen and frozen.num_hashes == 100 and not frozen.weighted
+
+# The unfrozen index answers queries through the independent build-phase path.
+reference = em.LSH(num_bands=25)
+reference.insert_batch(labels, labels)
+
+ids = frozen.doc_ids()
+assert sorted(ids) == sorted(labels)
+
+
+def unpack(offsets, ordinals):
+    assert offsets.dtype == np.uint64 and ordinals.dtype == np.uint32
+    assert offsets[0] == 0 and offsets[-1] == len(ordinals)
+    return [{ids[k] for k in ordinals[offsets[i]:offsets[i + 1]]} for i in range(len(offsets) - 1)]
+
+
+# Batch, signature and single queries agree with each other and with the unfrozen index.
+batch = unpack(*frozen.query_batch(phrases, thresholds=thresholds))
+sigs = frozen.signatures(phrases)
+assert sigs.shape == (len(phrases), 100) and sigs.dtype == np.uint64 and sigs.flags.c_contiguous
+assert sigs.base is not None and not sigs.flags.owndata
+by_sig = unpack(*frozen.query_signatures(sigs, thresholds=thresholds))
+by_sig_list = unpack(*frozen.query_signatures(sigs, list(thresholds)))
+by_sig_fortran = unpack(*frozen.query_signatures(np.asfortranarray(sigs), thresholds))
+scalar = unpack(*frozen.query_batch(phrases, 0.5))
+for i, phrase in enumerate(phrases):
+    expected = frozen.query(phrase, float(thresholds[i]))
+    assert batch[i] == expected == by_sig[i] == by_sig_list[i] == by_sig_fortran[i], phrase
+    assert expected == reference.query(phrase, threshold=float(thresholds[i])), phrase
+    assert scalar[i] == frozen.query(phrase, 0.5), phrase
+assert "smoked salmon oil" in frozen.query("smoked salmon oil", 0.9)
+
+# Errors surface as Python exceptions.
+expect_error(lambda: frozen.query_signatures(sigs[:, :50], 0.5), ValueError)
+expect_error(lambda: frozen.query_batch(phrases, [0.5]), ValueError)
+expect_error(lambda: frozen.query_batch([1, 2], 0.5), TypeError)
+expect_error(lambda: reference.query_batch(phrases, 0.5), RuntimeError)
+expect_error(lambda: frozen.insert("x", "x"), RuntimeError)
+expect_error(lambda: em.LSH(0), ValueError)
+expect_error(lambda: frozen.__init__(25, 100), RuntimeError)
+expect_error(lambda: reference.fit_idf(labels), RuntimeError)
+expect_error(lambda: em.LSH.__new__(em.LSH).query("x"), RuntimeError)
+
+# Empty inputs.
+offsets, ordinals = frozen.query_batch([], 0.5)
+assert offsets.tolist() == [0] and len(ordinals) == 0
+assert frozen.signatures([]).shape == (0, 100)
+
+# Save and load; an index file only loads into an index with a matching number of hashes.
+with tempfile.TemporaryDirectory() as directory:
+    path = os.path.join(directory, "index.bin")
+    assert reference.save(path)
+    loaded = em.LSH(25)
+    assert loaded.load(path)
+    loaded.freeze()
+    assert all(loaded.query(p, 0.5) == frozen.query(p, 0.5) for p in phrases)
+    assert not em.LSH(25, 50).load(path)
+    assert not em.LSH(20, 60).load(path)
+    assert not em.LSH(10, 200).load(path)
+    assert not em.LSH(25).load(os.path.join(directory, "missing.bin"))
+    with open(path, "rb") as file:
+        data = file.read()
+    with open(path, "wb") as file:
+        file.write(data[:len(data) // 2])
+    truncated = em.LSH(25)
+    assert not truncated.load(path)
+    truncated.freeze()
+    assert truncated.doc_ids() == []
+
+# IDF weighting and the tokenizers.
+weighted = em.LSH(25)
+weighted.fit_idf(labels)
+weighted.insert_batch(labels, labels)
+weighted.freeze()
+assert weighted.weighted and "smoked salmon oil" in weighted.query("smoked salmon oil", 0.9)
+assert em.text_to_ngrams("abcd", 3) == ["abc", "bcd"]
+assert em.filter_string("2 cups of the Flour") == ["cups", "flour"]
+
+# Queries from several threads at once give the same results as one thread.
+expected = frozen.query_batch(phrases, 0.5)
+with ThreadPoolExecutor(4) as pool:
+    results = list(pool.map(lambda _: frozen.query_batch(phrases, 0.5), range(16)))
+assert all((o == expected[0]).all() and (k == expected[1]).all() for o, k in results)
+
+# Inserts and a freeze racing with queries on the same index are serialized by its lock.
+racing = em.LSH(25)
+racing.insert_batch(labels[:100], labels[:100])
+stop = threading.Event()
+
+
+def query_until_stopped():
+    while not stop.is_set():
+        for phrase in phrases[:10]:
+            racing.query(phrase, 0.5)
+
+
+readers = [threading.Thread(target=query_until_stopped) for _ in range(3)]
+for reader in readers:
+    reader.start()
+for start in range(100, len(labels), 50):
+    racing.insert_batch(labels[start:start + 50], labels[start:start + 50])
+racing.freeze()
+stop.set()
+for reader in readers:
+    reader.join()
+assert sorted(racing.doc_ids()) == sorted(labels)
+
+# Result buffers are freed with their arrays, so repeated calls do not grow memory. Leaking the 320 KB
+# signature array of every call would add 32 MB.
+def max_rss():
+    return resource.getrusage(resource.RUSAGE_SELF).ru_maxrss
+
+
+short = ["a"] * 400
+for _ in range(20):
+    frozen.query_signatures(frozen.signatures(short), 0.5)
+gc.collect()
+before = max_rss()
+for _ in range(100):
+    frozen.query_signatures(frozen.signatures(short), 0.5)
+gc.collect()
+assert max_rss() - before < 10000
+
+print("python_bindings_test: ok")